@@ -28,7 +28,8 @@
 
 #include <SPI.h>
 #include <TMC2130Stepper.h>
-TMC2130Stepper TMC2130 = TMC2130Stepper(EN_PIN, DIR_PIN, STEP_PIN, CS_PIN);
+#include <TMC2130Stepper_FASTIO.h>
+TMC2130StepperT<EN_PIN, DIR_PIN, STEP_PIN, CS_PIN> TMC2130; // Pins resolved at compile time
 
 void setup() {
   //init serial port
@@ -70,8 +71,7 @@ void setup() {
 }
 
 ISR(TIMER1_COMPA_vect){
-  PORTF |= 1 << 0;
-  PORTF &= ~(1 << 0);
+  TMC2130.step_pulse();
 }
 
 void loop()
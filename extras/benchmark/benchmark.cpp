@@ -0,0 +1,355 @@
+/*
+	Bus cost of the public TMC2130Stepper API, measured on the host.
+
+	Every method is called `calls` times against a counting register file
+	backend. The output is CSV, one line per method:
+
+	method,frames,bytes,ns
+
+	frames and bytes are per call. A read is two datagrams unless the
+	previous datagram already requested the same register. CS is not
+	counted: a bus backend takes over the chip select, and both the
+	hardware SPI and TMC2130SoftSPI pull it low and back high exactly once
+	per datagram, so it would always be twice the frames. ns is the host
+	time per call including the backend. It is only useful for comparing
+	runs on the same machine. With -n the column is left out, so the output is
+	deterministic and can be diffed between library versions.
+
+	The inline aliases (stealthChop(), run_current(), ...) forward to the
+	methods listed here and are not measured separately. checkStatus() is
+	declared but has no definition. spi_stats() and clear_spi_stats() are
+	measured when built with -DTMC2130_SPI_STATS.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc extras/benchmark/benchmark.cpp src/source/[A-Z]*.cpp -o benchmark
+	./benchmark [-n] [calls] > before.csv
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <time.h>
+
+namespace {
+	struct counters_t {
+		uint32_t frames;
+		uint32_t bytes;
+	} count;
+
+	// Register file with the one datagram delayed read response of the chip
+	uint32_t regs[0x80];
+	uint32_t latch;
+
+	void backend(void *, uint8_t *d) {
+		count.frames++;
+		count.bytes += 5;
+
+		uint8_t address = d[0] & 0x7F;
+		uint32_t data = (uint32_t)d[1] << 24 | (uint32_t)d[2] << 16 | (uint32_t)d[3] << 8 | d[4];
+		if (d[0] & 0x80) regs[address] = data;
+		d[0] = 0;
+		d[1] = latch >> 24;
+		d[2] = latch >> 16;
+		d[3] = latch >> 8;
+		d[4] = latch;
+		latch = regs[address];
+	}
+
+	typedef void (*call_t)(TMC2130Stepper &d);
+
+	struct bench_t {
+		const char *name;
+		call_t call;
+	};
+
+	TMC2130_selftest_t selftest;
+	TMC2130_chopper_t chopper;
+	const TMC2130_motor_t motor = { 2.8, 1.5, 24 };
+	const uint32_t stream_buf[4] = { 0x00F80000UL, 0x000000F8UL, 0x01080000UL, 0x00000108UL };
+
+	// Not every method is called on the driver, e.g. the static coil_pack()
+	#define B(N, EXPR) { N, [](TMC2130Stepper &d) { (void)d; EXPR; } },
+
+	const bench_t benches[] = {
+		B("begin", 					d.begin())
+		B("rms_current(set)", 		d.rms_current(800))
+		B("rms_current", 			d.rms_current())
+		B("SilentStepStick2130", 	d.SilentStepStick2130(800))
+		B("setCurrent", 			d.setCurrent(800, 0.11, 0.5))
+		B("getCurrent", 			d.getCurrent())
+		B("checkOT", 				d.checkOT())
+		B("getOTPW", 				d.getOTPW())
+		B("clear_otpw", 			d.clear_otpw())
+		B("isEnabled", 				d.isEnabled())
+		B("selfTest", 				d.selfTest(selftest))
+		B("tuneChopper", 			d.tuneChopper(motor, chopper))
+		B("restore", 				d.restore())
+		B("shadow", 				d.shadow(REG_CHOPCONF))
+		B("bus_backend(set)", 		d.bus_backend(backend))
+		B("resync", 				d.resync())
+		B("bus_arbiter(set)", 		d.bus_arbiter(TMC2130Bus::spi))
+		B("bus_arbiter", 			d.bus_arbiter())
+		B("read_dropped", 			d.read_dropped())
+		B("auto_restore(set)", 		d.auto_restore(true))
+		B("auto_restore", 			d.auto_restore())
+		B("resets", 				d.resets())
+		B("restore_failures", 		d.restore_failures())
+		B("scrub", 					d.scrub())
+		B("scrub(rotation)", 		d.scrub(0xFFFF))
+		// Also rewrites the write only registers, one per call
+		B("scrub(refresh)", 		d.scrub_refresh(true); d.scrub(); d.scrub_refresh(false))
+		B("scrub(refresh,rotation)", d.scrub_refresh(true); d.scrub(0xFFFF); d.scrub_refresh(false))
+		B("scrub_refresh(set)", 	d.scrub_refresh(false))
+		B("scrub_mismatches", 		d.scrub_mismatches(REG_GCONF))
+		B("scrub_checks", 			d.scrub_checks())
+		B("scrub_clear", 			d.scrub_clear())
+#ifdef TMC2130_SPI_STATS
+		B("spi_stats", 				d.spi_stats())
+		B("clear_spi_stats", 		d.clear_spi_stats())
+#endif
+		// GCONF
+		B("GCONF(set)", 			d.GCONF(0))
+		B("GCONF", 					d.GCONF())
+		B("I_scale_analog(set)", 	d.I_scale_analog(true))
+		B("internal_Rsense(set)", 	d.internal_Rsense(false))
+		B("en_pwm_mode(set)", 		d.en_pwm_mode(true))
+		B("enc_commutation(set)", 	d.enc_commutation(false))
+		B("shaft(set)", 			d.shaft(false))
+		B("diag0_error(set)", 		d.diag0_error(false))
+		B("diag0_otpw(set)", 		d.diag0_otpw(false))
+		B("diag0_stall(set)", 		d.diag0_stall(false))
+		B("diag1_stall(set)", 		d.diag1_stall(false))
+		B("diag1_index(set)", 		d.diag1_index(false))
+		B("diag1_onstate(set)", 	d.diag1_onstate(false))
+		B("diag1_steps_skipped(set)", d.diag1_steps_skipped(false))
+		B("diag0_int_pushpull(set)", d.diag0_int_pushpull(false))
+		B("diag1_pushpull(set)", 	d.diag1_pushpull(false))
+		B("small_hysterisis(set)", 	d.small_hysterisis(false))
+		B("stop_enable(set)", 		d.stop_enable(false))
+		B("direct_mode(set)", 		d.direct_mode(false))
+		B("I_scale_analog", 		d.I_scale_analog())
+		B("internal_Rsense", 		d.internal_Rsense())
+		B("en_pwm_mode", 			d.en_pwm_mode())
+		B("enc_commutation", 		d.enc_commutation())
+		B("shaft", 					d.shaft())
+		B("diag0_error", 			d.diag0_error())
+		B("diag0_otpw", 			d.diag0_otpw())
+		B("diag0_stall", 			d.diag0_stall())
+		B("diag1_stall", 			d.diag1_stall())
+		B("diag1_index", 			d.diag1_index())
+		B("diag1_onstate", 			d.diag1_onstate())
+		B("diag1_steps_skipped", 	d.diag1_steps_skipped())
+		B("diag0_int_pushpull", 	d.diag0_int_pushpull())
+		B("diag1_pushpull", 		d.diag1_pushpull())
+		B("small_hysterisis", 		d.small_hysterisis())
+		B("stop_enable", 			d.stop_enable())
+		B("direct_mode", 			d.direct_mode())
+		// IHOLD_IRUN
+		B("IHOLD_IRUN(set)", 		d.IHOLD_IRUN(0x61010))
+		B("IHOLD_IRUN", 			d.IHOLD_IRUN())
+		B("ihold(set)", 			d.ihold(10))
+		B("irun(set)", 				d.irun(16))
+		B("iholddelay(set)", 		d.iholddelay(6))
+		B("ihold", 					d.ihold())
+		B("irun", 					d.irun())
+		B("iholddelay", 			d.iholddelay())
+		// GSTAT
+		B("GSTAT(set)", 			d.GSTAT(RESET_bm))
+		B("GSTAT", 					d.GSTAT())
+		B("reset", 					d.reset())
+		B("drv_err", 				d.drv_err())
+		B("uv_cp", 					d.uv_cp())
+		// IOIN
+		B("IOIN", 					d.IOIN())
+		B("step", 					d.step())
+		B("dir", 					d.dir())
+		B("dcen_cfg4", 				d.dcen_cfg4())
+		B("dcin_cfg5", 				d.dcin_cfg5())
+		B("drv_enn_cfg6", 			d.drv_enn_cfg6())
+		B("dco", 					d.dco())
+		B("version", 				d.version())
+		// Single value registers
+		B("TPOWERDOWN(set)", 		d.TPOWERDOWN(128))
+		B("TPOWERDOWN", 			d.TPOWERDOWN())
+		B("TSTEP", 					d.TSTEP())
+		B("TPWMTHRS(set)", 			d.TPWMTHRS(500))
+		B("TPWMTHRS", 				d.TPWMTHRS())
+		B("TCOOLTHRS(set)", 		d.TCOOLTHRS(1000))
+		B("TCOOLTHRS", 				d.TCOOLTHRS())
+		B("THIGH(set)", 			d.THIGH(100))
+		B("THIGH", 					d.THIGH())
+		// XDIRECT
+		B("XDIRECT(set)", 			d.XDIRECT(0))
+		B("XDIRECT", 				d.XDIRECT())
+		B("coil_A(set)", 			d.coil_A(100))
+		B("coil_B(set)", 			d.coil_B(-100))
+		B("coil_A", 				d.coil_A())
+		B("coil_B", 				d.coil_B())
+		B("coil_AB", 				d.coil_AB(100, -100))
+		B("coil_pack", 				TMC2130Stepper::coil_pack(100, -100))
+		B("stream_begin", 			d.stream_begin(stream_buf, 4, 1))
+		B("stream_tick", 			host_advance(1); d.stream_tick())
+		B("streaming", 				d.streaming())
+		B("stream_stats", 			d.stream_stats())
+		B("stream_end", 			d.stream_end())
+		// VDCMIN
+		B("VDCMIN(set)", 			d.VDCMIN(0))
+		B("VDCMIN", 				d.VDCMIN())
+		// CHOPCONF
+		B("CHOPCONF(set)", 			d.CHOPCONF(0x10018005UL))
+		B("CHOPCONF", 				d.CHOPCONF())
+		B("toff(set)", 				d.toff(5))
+		B("hstrt(set)", 			d.hstrt(4))
+		B("hend(set)", 				d.hend(1))
+		B("fd(set)", 				d.fd(0))
+		B("disfdcc(set)", 			d.disfdcc(false))
+		B("rndtf(set)", 			d.rndtf(false))
+		B("chm(set)", 				d.chm(false))
+		B("tbl(set)", 				d.tbl(2))
+		B("vsense(set)", 			d.vsense(true))
+		B("vhighfs(set)", 			d.vhighfs(false))
+		B("vhighchm(set)", 			d.vhighchm(false))
+		B("sync(set)", 				d.sync(0))
+		B("mres(set)", 				d.mres(4))
+		B("intpol(set)", 			d.intpol(true))
+		B("dedge(set)", 			d.dedge(false))
+		B("diss2g(set)", 			d.diss2g(false))
+		B("toff", 					d.toff())
+		B("hstrt", 					d.hstrt())
+		B("hend", 					d.hend())
+		B("fd", 					d.fd())
+		B("disfdcc", 				d.disfdcc())
+		B("rndtf", 					d.rndtf())
+		B("chm", 					d.chm())
+		B("tbl", 					d.tbl())
+		B("vsense", 				d.vsense())
+		B("vhighfs", 				d.vhighfs())
+		B("vhighchm", 				d.vhighchm())
+		B("sync", 					d.sync())
+		B("mres", 					d.mres())
+		B("intpol", 				d.intpol())
+		B("dedge", 					d.dedge())
+		B("diss2g", 				d.diss2g())
+		// COOLCONF
+		B("COOLCONF(set)", 			d.COOLCONF(0))
+		B("COOLCONF", 				d.COOLCONF())
+		B("semin(set)", 			d.semin(5))
+		B("seup(set)", 				d.seup(1))
+		B("semax(set)", 			d.semax(2))
+		B("sedn(set)", 				d.sedn(1))
+		B("seimin(set)", 			d.seimin(false))
+		B("sgt(set)", 				d.sgt(0))
+		B("sfilt(set)", 			d.sfilt(false))
+		B("semin", 					d.semin())
+		B("seup", 					d.seup())
+		B("semax", 					d.semax())
+		B("sedn", 					d.sedn())
+		B("seimin", 				d.seimin())
+		B("sgt", 					d.sgt())
+		B("sfilt", 					d.sfilt())
+		// DCCTRL
+		B("DCCTRL(set)", 			d.DCCTRL(0))
+		B("DCCTRL", 				d.DCCTRL())
+		B("dc_time(set)", 			d.dc_time(100))
+		B("dc_sg(set)", 			d.dc_sg(5))
+		B("dc_time", 				d.dc_time())
+		B("dc_sg", 					d.dc_sg())
+		// PWMCONF
+		B("PWMCONF(set)", 			d.PWMCONF(0x00050480UL))
+		B("PWMCONF", 				d.PWMCONF())
+		B("pwm_ampl(set)", 			d.pwm_ampl(128))
+		B("pwm_grad(set)", 			d.pwm_grad(4))
+		B("pwm_freq(set)", 			d.pwm_freq(1))
+		B("pwm_autoscale(set)", 	d.pwm_autoscale(true))
+		B("pwm_symmetric(set)", 	d.pwm_symmetric(false))
+		B("freewheel(set)", 		d.freewheel(0))
+		B("pwm_ampl", 				d.pwm_ampl())
+		B("pwm_grad", 				d.pwm_grad())
+		B("pwm_freq", 				d.pwm_freq())
+		B("pwm_autoscale", 			d.pwm_autoscale())
+		B("pwm_symmetric", 			d.pwm_symmetric())
+		B("freewheel", 				d.freewheel())
+		// DRV_STATUS
+		B("DRV_STATUS", 			d.DRV_STATUS())
+		B("sg_result", 				d.sg_result())
+		B("fsactive", 				d.fsactive())
+		B("cs_actual", 				d.cs_actual())
+		B("stallguard", 			d.stallguard())
+		B("ot", 					d.ot())
+		B("otpw", 					d.otpw())
+		B("s2ga", 					d.s2ga())
+		B("s2gb", 					d.s2gb())
+		B("ola", 					d.ola())
+		B("olb", 					d.olb())
+		B("stst", 					d.stst())
+		B("PWM_SCALE", 				d.PWM_SCALE())
+		B("MSCNT", 					d.MSCNT())
+		// ENCM_CTRL
+		B("ENCM_CTRL(set)", 		d.ENCM_CTRL(0))
+		B("ENCM_CTRL", 				d.ENCM_CTRL())
+		B("inv(set)", 				d.inv(false))
+		B("maxspeed(set)", 			d.maxspeed(false))
+		B("inv", 					d.inv())
+		B("maxspeed", 				d.maxspeed())
+		B("LOST_STEPS", 			d.LOST_STEPS())
+		// Helpers
+		B("microsteps(set)", 		d.microsteps(16))
+		B("microsteps", 			d.microsteps())
+		B("blank_time(set)", 		d.blank_time(24))
+		B("blank_time", 			d.blank_time())
+		B("hysterisis_low(set)", 	d.hysterisis_low(1))
+		B("hysterisis_low", 		d.hysterisis_low())
+		B("hysterisis_start(set)", 	d.hysterisis_start(4))
+		B("hysterisis_start", 		d.hysterisis_start())
+		B("sg_current_decrease(set)", d.sg_current_decrease(2))
+		B("sg_current_decrease", 	d.sg_current_decrease())
+		B("tstep_to_speed", 		d.tstep_to_speed(100))
+		B("speed_to_tstep", 		d.speed_to_tstep(1000))
+		B("velocity", 				d.velocity())
+		B("velocity_raw", 			d.velocity_raw())
+		B("velocity_filter", 		d.velocity_filter(3))
+		B("dcstep_speed(set)", 		d.dcstep_speed(500))
+		B("dcstep_speed", 			d.dcstep_speed())
+		B("dcstep_auto", 			d.dcstep_auto())
+		B("dcstep_pins", 			d.dcstep_pins(0xFF, 0xFF))
+		B("dcstep_enable", 			d.dcstep_enable(false))
+		B("dcstep_wait", 			d.dcstep_wait())
+		B("dcstep_ready", 			d.dcstep_ready(10))
+		B("dcstep_waits", 			d.dcstep_waits())
+		B("dcstep_stalls", 			d.dcstep_stalls())
+	};
+
+	#undef B
+
+	uint64_t now_ns() {
+		timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	}
+}
+
+int main(int argc, char **argv) {
+	bool timing = true;
+	uint32_t calls = 1000;
+	for (int i = 1; i < argc; i++) {
+		if (!strcmp(argv[i], "-n")) timing = false;
+		else calls = max(1, atoi(argv[i]));
+	}
+
+	regs[REG_IOIN] = 0x11UL << 24;
+	TMC2130Stepper driver(2, 3, 4, 10);
+	driver.bus_backend(backend);
+	driver.begin();
+
+	printf("method,frames,bytes%s\n", timing ? ",ns" : "");
+	for (const bench_t &b : benches) {
+		count = counters_t();
+		uint64_t start = now_ns();
+		for (uint32_t i = 0; i < calls; i++) b.call(driver);
+		uint64_t ns = now_ns() - start;
+
+		printf("%s,%.2f,%.2f", b.name, (double)count.frames / calls, (double)count.bytes / calls);
+		if (timing) printf(",%.1f", (double)ns / calls);
+		printf("\n");
+	}
+	return 0;
+}
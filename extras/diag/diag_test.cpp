@@ -0,0 +1,133 @@
+/*
+	Host tests of the DIAG pin event dispatch (TMC2130Diag).
+
+	The simulated driver drives DIAG0 and DIAG1 as routed in GCONF:
+	- index pulses on DIAG1 are counted without a bus access
+	- a stall on DIAG0 is told apart by one DRV_STATUS read and
+	  delivered to the handlers registered for it
+	- a short circuit is delivered as DIAG_EVENT_ERROR
+	- a stall that is over before dispatch() reports all events routed
+	  to DIAG0 instead of none
+	- events not available on a pin are rejected by begin()
+
+	Exits with 1 when a check fails.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/diag/diag_test.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o diag_test
+	./diag_test
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Stepper_DIAG.h>
+#include <TMC2130Sim.h>
+
+#define EN_PIN		2
+#define PIN_DIAG0	20
+#define PIN_DIAG1	21
+#define DIAG0_EVENTS	(DIAG_EVENT_ERROR|DIAG_EVENT_OTPW|DIAG_EVENT_STALL)
+
+namespace {
+	TMC2130Stepper driver(EN_PIN, 3, 4, 10);
+	TMC2130Sim sim(EN_PIN, 3, 4);
+	TMC2130Diag diag(driver, PIN_DIAG0, PIN_DIAG1);
+	uint32_t failures = 0;
+	uint8_t handled = 0;		// Events passed to the handler
+	uint32_t handled_status = 0;
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+
+	void handler(uint8_t events, uint32_t drv_status) {
+		handled |= events;
+		handled_status = drv_status;
+	}
+
+	void wait_ms(uint16_t ms) {
+		for (uint16_t i = 0; i < ms; i++) {
+			delay(1);
+			sim.update();
+		}
+	}
+
+	void test_index() {
+		uint32_t frames = sim.frames();
+		int32_t start = sim.position();
+		sim.run(1000);
+		wait_ms(500);
+		sim.run(0);
+		uint32_t cycles = (sim.position() - start) / 1024;	// MSCNT passes 0 once per electrical cycle
+		handled = 0;
+		check(diag.dispatch() == DIAG_EVENT_INDEX, "index dispatched");
+		check(diag.index_pulses() == cycles, "one index pulse per electrical cycle");
+		check(diag.count(DIAG_EVENT_INDEX) == 1, "index dispatch counted");
+		check(sim.frames() == frames && diag.status_reads() == 0, "index pulses cost no bus access");
+		check(handled == 0, "index not passed to a stall handler");
+	}
+
+	void test_stall() {
+		sim.run(1000);
+		sim.motor.load = 2;
+		wait_ms(50);
+		handled = 0;
+		uint8_t events = diag.dispatch();
+		check(events & DIAG_EVENT_STALL, "stall dispatched");
+		check(!(events & (DIAG_EVENT_ERROR|DIAG_EVENT_OTPW)), "stall alone");
+		check(diag.status_reads() == 1, "one DRV_STATUS read");
+		check(handled == DIAG_EVENT_STALL && (handled_status & STALLGUARD_bm), "handler gets the stall and DRV_STATUS");
+		check(diag.dispatch() == 0, "stall reported once");
+		sim.motor.load = 0.2;
+		sim.run(0);
+		wait_ms(10);
+		diag.dispatch();
+	}
+
+	void test_error() {
+		handled = 0;
+		sim.fault(S2GA_bm);
+		check(diag.dispatch() == DIAG_EVENT_ERROR, "short to ground dispatched as an error");
+		check(handled == DIAG_EVENT_ERROR, "handler gets the error");
+		sim.fault(0);
+		diag.dispatch();
+	}
+
+	// The stall is over when dispatch() reads DRV_STATUS, nothing tells DIAG0's events apart
+	void test_unflagged() {
+		sim.run(1000);
+		sim.motor.load = 2;
+		wait_ms(50);
+		sim.motor.load = 0.2;
+		sim.run(0);
+		wait_ms(10);
+		check(!(sim.peek(REG_DRV_STATUS) & STALLGUARD_bm), "stall over");
+		check((diag.dispatch() & ~DIAG_EVENT_INDEX) == DIAG0_EVENTS, "unflagged DIAG0 reports all its events");
+	}
+}
+
+int main() {
+	sim.attach(driver);
+	sim.diag_pins(PIN_DIAG0, PIN_DIAG1);
+	driver.begin();
+	driver.rms_current(800);
+	driver.microsteps(16);
+	driver.TCOOLTHRS(0xFFFFF);
+	driver.sgt(0);
+	digitalWrite(EN_PIN, LOW);
+
+	check(!TMC2130Diag(driver, PIN_DIAG0).begin(DIAG_EVENT_INDEX), "index rejected on DIAG0");
+	check(!TMC2130Diag(driver, PIN_DIAG0).begin(0, DIAG_EVENT_STALL), "DIAG1 not connected");
+	check(diag.begin(DIAG0_EVENTS, DIAG_EVENT_INDEX), "begin");
+	check(diag.on(DIAG0_EVENTS, handler), "on");
+
+	test_index();
+	test_stall();
+	test_error();
+	test_unflagged();
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+#!/usr/bin/env python3
+"""
+Host side of the TMC2130Protocol binary frames.
+
+Usage:
+	protocol.py get <name|id>			frame reading a parameter
+	protocol.py set <name|id> <value>	frame setting a parameter
+	protocol.py count					frame asking for the number of parameters
+	protocol.py decode [capture.bin]	print the reply frames in a capture
+	protocol.py test					check against the library's test vectors
+
+Frames are written to stdout as binary, e.g.
+	protocol.py set sg_stall_value -10 > /dev/ttyACM0
+Parameter names are looked up in the table in TMC2130Stepper_PROTOCOL.cpp.
+Bytes between frames, like text printed by the sketch, are skipped.
+"""
+import os
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+FRAME = 8
+SET, GET, COUNT = 0x01, 0x02, 0x03
+OK, ERR = 0x80, 0x40
+
+SOURCE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+	'..', '..', 'src', 'source', 'TMC2130Stepper_PROTOCOL.cpp')
+
+
+def crc8(data):
+	# Polynomial x^8+x^2+x+1, as TMC2130Protocol::crc8()
+	crc = 0
+	for b in data:
+		crc ^= b
+		for _ in range(8):
+			crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+	return crc
+
+
+def encode(cmd, id, value):
+	frame = struct.pack('>BBBi', SYNC, cmd, id, value)
+	return frame + bytes([crc8(frame)])
+
+
+def decode(frame):
+	# Returns (cmd, id, value), or None when the frame is invalid
+	if len(frame) != FRAME or frame[0] != SYNC or crc8(frame[:-1]) != frame[-1]:
+		return None
+	_, cmd, id, value = struct.unpack('>BBBi', frame[:-1])
+	return cmd, id, value
+
+
+def frames(data):
+	# Slides one byte at a time past anything that is not a valid frame
+	pos = 0
+	while pos + FRAME <= len(data):
+		f = decode(data[pos:pos+FRAME])
+		if f is None:
+			pos += 1
+			continue
+		yield f
+		pos += FRAME
+
+
+def params(source=SOURCE):
+	# The ids are the positions in the TMC2130_PARAMS table
+	with open(source) as f:
+		text = f.read()
+	table = re.search(r'#define TMC2130_PARAMS\(RW, RO\)(.*?)\n\n', text, re.S).group(1)
+	return re.findall(r'R[WO]\((\w+)\)', table)
+
+
+def param_id(arg):
+	return int(arg, 0) if arg[0].isdigit() else params().index(arg)
+
+
+def test():
+	assert crc8(b'123456789') == 0xF4
+	assert encode(SET, 0x13, 7) == bytes([0xA5, 0x01, 0x13, 0x00, 0x00, 0x00, 0x07, 0x29])
+	for value in (0, 1, -1, 0x12345678, -0x80000000, 0x7FFFFFFF):
+		assert decode(encode(GET, 3, value)) == (GET, 3, value)
+	f = bytearray(encode(SET, 17, 7))
+	for bit in range(8*FRAME):
+		f[bit//8] ^= 1 << bit%8
+		assert decode(bytes(f)) is None
+		f[bit//8] ^= 1 << bit%8
+	good = encode(COUNT | OK, 0, 70)
+	assert list(frames(b'\xa5\x00' + good + b'ok\r\n' + good[:5])) == [(COUNT | OK, 0, 70)]
+	print('PASS')
+
+
+def main():
+	args = sys.argv[1:]
+	if not args:
+		sys.exit(__doc__)
+	cmd = args[0]
+	if cmd == 'test':
+		test()
+	elif cmd == 'decode':
+		src = open(args[1], 'rb') if len(args) > 1 else sys.stdin.buffer
+		names = params()
+		for c, id, value in frames(src.read()):
+			name = names[id] if id < len(names) else str(id)
+			status = 'ok' if c & OK else 'error' if c & ERR else 'request'
+			print('%s %s %d %s' % ({SET: 'set', GET: 'get', COUNT: 'count'}.get(c & 0x3F, hex(c)), name, value, status))
+	else:
+		if cmd == 'count':
+			frame = encode(COUNT, 0, 0)
+		elif cmd == 'get':
+			frame = encode(GET, param_id(args[1]), 0)
+		elif cmd == 'set':
+			frame = encode(SET, param_id(args[1]), int(args[2], 0))
+		else:
+			sys.exit(__doc__)
+		sys.stdout.buffer.write(frame)
+
+
+if __name__ == '__main__':
+	main()
@@ -0,0 +1,192 @@
+/*
+	Host tests of the live tuning protocol (TMC2130Protocol).
+
+	- crc8() against the CRC-8/SMBUS check value
+	- the frame layout against a fixed test vector
+	- encode() and decode() round trips and single bit errors
+	- binary frames through feed(): set, get, count, errors
+	- resynchronisation after noise and corrupted frames
+	- text commands and replies
+
+	A simulated driver answers the register accesses. Exits with 1 when
+	a check fails.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/protocol/protocol_test.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o protocol_test
+	./protocol_test
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_PROTOCOL.h>
+#include <TMC2130Sim.h>
+
+namespace {
+	TMC2130Stepper driver(2, 3, 4, 10);
+	TMC2130Sim sim(2, 3, 4);
+	TMC2130Protocol proto(driver);
+	uint32_t failures = 0;
+
+	// Collects what the protocol writes back
+	class Capture : public Print {
+		public:
+			size_t write(uint8_t c) {
+				if (len < sizeof(buf)) buf[len++] = c;
+				return 1;
+			}
+			void clear() { len = 0; }
+			bool text(const char *s) { return len == strlen(s) && memcmp(buf, s, len) == 0; }
+			uint8_t buf[256];
+			size_t len = 0;
+	} out;
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+
+	void feed(const uint8_t *data, size_t len) {
+		for (size_t i = 0; i < len; i++) proto.feed(data[i], out);
+	}
+
+	void feed(const char *s) { feed((const uint8_t *)s, strlen(s)); }
+
+	// Sends one frame and decodes the single reply
+	bool request(uint8_t cmd, uint8_t id, int32_t value, uint8_t &reply, int32_t &result) {
+		uint8_t frame[TMC2130_PROTO_FRAME];
+		TMC2130Protocol::encode(frame, cmd, id, value);
+		out.clear();
+		feed(frame, sizeof(frame));
+		uint8_t reply_id;
+		return out.len == TMC2130_PROTO_FRAME
+			&& TMC2130Protocol::decode(out.buf, reply, reply_id, result)
+			&& reply_id == id;
+	}
+
+	void test_crc() {
+		check(TMC2130Protocol::crc8((const uint8_t *)"123456789", 9) == 0xF4, "crc8 check value");
+		check(TMC2130Protocol::crc8(NULL, 0) == 0, "crc8 of nothing");
+	}
+
+	void test_round_trip() {
+		// Same vector as extras/protocol/protocol.py
+		const uint8_t expected[TMC2130_PROTO_FRAME] = { 0xA5, 0x01, 0x13, 0x00, 0x00, 0x00, 0x07, 0x29 };
+		uint8_t encoded[TMC2130_PROTO_FRAME];
+		TMC2130Protocol::encode(encoded, TMC2130_PROTO_SET, 0x13, 7);
+		check(memcmp(encoded, expected, sizeof(expected)) == 0, "encode test vector");
+
+		const int32_t values[] = { 0, 1, -1, 127, -128, 0x12345678, (int32_t)0x80000000, 0x7FFFFFFF, (int32_t)0xA5A5A5A5 };
+		for (uint8_t v = 0; v < sizeof(values)/sizeof(values[0]); v++) {
+			for (uint16_t cmd = 0; cmd < 256; cmd += 51) {
+				uint8_t frame[TMC2130_PROTO_FRAME], c, id;
+				int32_t value;
+				TMC2130Protocol::encode(frame, cmd, v, values[v]);
+				check(frame[0] == TMC2130_PROTO_SYNC, "sync byte");
+				check(TMC2130Protocol::decode(frame, c, id, value), "decode");
+				check(c == cmd && id == v && value == values[v], "round trip");
+
+				for (uint8_t bit = 0; bit < 8*TMC2130_PROTO_FRAME; bit++) {
+					frame[bit/8] ^= 1 << (bit%8);
+					check(!TMC2130Protocol::decode(frame, c, id, value), "single bit error detected");
+					frame[bit/8] ^= 1 << (bit%8);
+				}
+			}
+		}
+	}
+
+	void test_binary() {
+		uint8_t reply;
+		int32_t value;
+		int16_t id = TMC2130Protocol::find("hold_delay");
+		check(id >= 0, "find");
+
+		check(request(TMC2130_PROTO_SET, id, 7, reply, value), "set reply");
+		check(reply == (TMC2130_PROTO_SET | TMC2130_PROTO_OK) && value == 7, "set result");
+		check(driver.hold_delay() == 7, "set reached the driver");
+		check(request(TMC2130_PROTO_GET, id, 0, reply, value), "get reply");
+		check(reply == (TMC2130_PROTO_GET | TMC2130_PROTO_OK) && value == 7, "get result");
+
+		check(request(TMC2130_PROTO_COUNT, 0, 0, reply, value), "count reply");
+		check(reply == (TMC2130_PROTO_COUNT | TMC2130_PROTO_OK) && value == TMC2130Protocol::params(), "count result");
+
+		check(request(TMC2130_PROTO_GET, TMC2130Protocol::params(), 0, reply, value), "unknown id reply");
+		check(reply == (TMC2130_PROTO_GET | TMC2130_PROTO_ERR), "unknown id fails");
+		id = TMC2130Protocol::find("sg_result");
+		check(!TMC2130Protocol::writable(id), "sg_result is read only");
+		check(request(TMC2130_PROTO_SET, id, 1, reply, value), "read only reply");
+		check(reply == (TMC2130_PROTO_SET | TMC2130_PROTO_ERR), "read only set fails");
+		check(request(0x3F, 0, 0, reply, value), "unknown command reply");
+		check(reply == (0x3F | TMC2130_PROTO_ERR), "unknown command fails");
+	}
+
+	void test_resync() {
+		int16_t id = TMC2130Protocol::find("hold_delay");
+		uint8_t frame[TMC2130_PROTO_FRAME], reply, reply_id;
+		int32_t value;
+		TMC2130Protocol::encode(frame, TMC2130_PROTO_GET, id, 0);
+
+		// Noise containing sync bytes in front of a frame
+		const uint8_t noise[] = { TMC2130_PROTO_SYNC, 0x00, TMC2130_PROTO_SYNC, TMC2130_PROTO_SYNC, 0x13 };
+		for (uint8_t n = 1; n <= sizeof(noise); n++) {
+			out.clear();
+			feed(noise, n);
+			feed(frame, sizeof(frame));
+			check(out.len == TMC2130_PROTO_FRAME && TMC2130Protocol::decode(out.buf, reply, reply_id, value)
+				&& reply_id == id && value == 7, "frame after noise");
+		}
+
+		// A corrupted frame gets no reply and does not swallow the next one
+		uint8_t bad[TMC2130_PROTO_FRAME];
+		for (uint8_t byte = 1; byte < TMC2130_PROTO_FRAME; byte++) {
+			memcpy(bad, frame, sizeof(bad));
+			bad[byte] = TMC2130_PROTO_SYNC;
+			if (bad[byte] == frame[byte]) continue;
+			out.clear();
+			feed(bad, sizeof(bad));
+			feed(frame, sizeof(frame));
+			check(out.len == TMC2130_PROTO_FRAME && TMC2130Protocol::decode(out.buf, reply, reply_id, value)
+				&& value == 7, "frame after corrupted frame");
+		}
+
+		// Truncated frame: the next frame starts inside it
+		out.clear();
+		feed(frame, 3);
+		feed(frame, sizeof(frame));
+		check(out.len == TMC2130_PROTO_FRAME && TMC2130Protocol::decode(out.buf, reply, reply_id, value)
+			&& value == 7, "frame after truncated frame");
+	}
+
+	void test_text() {
+		out.clear();
+		feed("hold_delay 3\n");
+		check(out.text("hold_delay 3\r\n"), "text set");
+		check(driver.hold_delay() == 3, "text set reached the driver");
+		out.clear();
+		feed("hold_delay\r\n");
+		check(out.text("hold_delay 3\r\n"), "text get");
+		out.clear();
+		feed("sg_result 5\n");
+		check(out.text("Read only!\r\n"), "text read only");
+		out.clear();
+		feed("no_such_parameter\n");
+		check(out.text("Invalid command!\r\n"), "text unknown");
+		out.clear();
+		feed("hold_delay 0123456789012345678901234567890123456789\nhold_delay\n");
+		check(out.text("hold_delay 3\r\n"), "text overflow dropped");
+	}
+}
+
+int main() {
+	sim.attach(driver);
+	driver.begin();
+
+	test_crc();
+	test_round_trip();
+	test_binary();
+	test_resync();
+	test_text();
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
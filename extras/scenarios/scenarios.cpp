@@ -0,0 +1,168 @@
+/*
+	Scenario runs against the simulated TMC2130 (extras/simulator).
+
+	- SPI: the one datagram delayed reply, write only registers reading
+	  as zero, GSTAT clear on read and the reset flag in the status byte
+	- restore: a power cycle is detected and the configuration restored
+	- motor: TSTEP follows the step rate, SG_RESULT falls with the load,
+	  the motor stalls and loses steps above the available torque and
+	  OTPW trips at full current
+	- sweep: a stallGuard threshold search over speeds and SGT values,
+	  the way a tuning algorithm would use the model. For every speed the
+	  SGT closest to zero is picked that reads SG_RESULT 0 at 90% of the
+	  available torque and leaves at least SG_MARGIN at the nominal load.
+
+	Exits with 1 when a check fails. The run time is wall clock; all
+	other output depends only on the model.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/scenarios/scenarios.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o scenarios
+	./scenarios
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Stepper_REGMAP.h>
+#include <TMC2130Sim.h>
+#include <time.h>
+
+#define EN_PIN 			2
+#define DIR_PIN 		3
+#define STEP_PIN 		4
+#define NOMINAL_LOAD 	0.3
+#define SG_MARGIN 		100
+
+namespace {
+	TMC2130Stepper driver(EN_PIN, DIR_PIN, STEP_PIN, 10);
+	TMC2130Sim sim(EN_PIN, DIR_PIN, STEP_PIN);
+	uint32_t failures = 0;
+	uint32_t scenarios = 0;
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+
+	// One raw datagram to a model without a driver in front, returns the data part of the reply
+	uint32_t datagram(TMC2130Sim &chip, uint8_t address, uint32_t data, uint8_t &status) {
+		uint8_t d[5] = { address, (uint8_t)(data >> 24), (uint8_t)(data >> 16), (uint8_t)(data >> 8), (uint8_t)data };
+		chip.datagram(d);
+		status = d[0];
+		return (uint32_t)d[1] << 24 | (uint32_t)d[2] << 16 | (uint32_t)d[3] << 8 | d[4];
+	}
+
+	void spi() {
+		TMC2130Sim chip(20, 21, 22);
+		uint8_t status;
+		datagram(chip, TMC2130_WRITE|REG_CHOPCONF, 0x00010008, status);
+		check(status & STATUS_RESET_bm, "reset flag after power on");
+		check(datagram(chip, TMC2130_READ|REG_IHOLD_IRUN, 0, status) == 0x00010008, "reply to a write is the written register");
+		check(datagram(chip, TMC2130_READ|REG_GSTAT, 0, status) == 0, "write only register reads as zero");
+		check(datagram(chip, TMC2130_READ|REG_GSTAT, 0, status) == RESET_bm, "GSTAT reports the reset");
+		check(datagram(chip, TMC2130_READ|REG_CHOPCONF, 0, status) == 0, "GSTAT is cleared by reading it");
+		check(!(status & STATUS_RESET_bm), "reset flag cleared");
+		check(datagram(chip, TMC2130_READ|REG_CHOPCONF, 0, status) == 0x00010008, "reply is one datagram late");
+		chip.power_cycle();
+		check(datagram(chip, TMC2130_READ|REG_CHOPCONF, 0, status) == 0 && (status & STATUS_RESET_bm), "power cycle");
+	}
+
+	void restore() {
+		uint16_t resets = driver.resets();
+		uint32_t chopconf = driver.CHOPCONF();
+		sim.power_cycle();
+		driver.GCONF();
+		check(driver.resets() == resets + 1, "reset detected");
+		check(sim.peek(REG_CHOPCONF) == chopconf, "CHOPCONF restored");
+		check(!(sim.peek(REG_GSTAT) & RESET_bm), "GSTAT.reset cleared");
+	}
+
+	// Runs at steps_per_s against load and returns SG_RESULT
+	uint16_t load_point(float steps_per_s, float load) {
+		scenarios++;
+		sim.motor.load = load;
+		sim.run(steps_per_s);
+		delay(20);
+		return driver.sg_result();
+	}
+
+	// Torque the model can deliver at a speed, without coolStep
+	float available(float steps_per_s) {
+		float fullsteps = steps_per_s / driver.microsteps();
+		return sim.motor.torque * (driver.irun()+1) / 32 * (1 - fullsteps / sim.motor.max_fullsteps);
+	}
+
+	void motor() {
+		sim.run(1000);
+		delay(10);
+		uint32_t tstep = driver.TSTEP();
+		check(tstep >= 749 && tstep <= 751, "TSTEP at 1000 steps/s and 16 microsteps");
+
+		uint16_t last = 1024;
+		for (float load = 0; load < 0.7; load += 0.1) {
+			uint16_t sg = load_point(1000, load);
+			check(sg < last, "SG_RESULT falls with the load");
+			last = sg;
+		}
+		uint32_t lost = sim.lost_steps();
+		load_point(1000, available(1000) * 1.1);
+		check(driver.stallguard() && sim.lost_steps() > lost, "stall above the available torque");
+		load_point(1000, NOMINAL_LOAD);
+		check(!driver.stallguard(), "running again below the available torque");
+
+		sim.run(0);
+		sim.motor.heating = 140;
+		uint32_t ihold_irun = driver.IHOLD_IRUN();
+		driver.hold_current(31);
+		driver.run_current(31);
+		uint16_t s;
+		for (s = 0; s < 600 && !driver.otpw(); s++) delay(1000);
+		check(driver.otpw() && !driver.ot(), "OTPW at full current");
+		printf("motor: OTPW after %us at %.0fC\n", s, sim.temperature());
+		sim.motor.heating = 60;
+		driver.IHOLD_IRUN(ihold_irun);
+		delay(600000);	// Cool down
+	}
+
+	void sweep() {
+		printf("steps_per_s,sgt,sg_nominal,sg_near_stall\n");
+		for (uint16_t speed = 500; speed <= 3000; speed += 250) {
+			int8_t best = 64;
+			uint16_t best_nominal = 0, best_stall = 0;
+			for (int8_t sgt = -10; sgt <= 10; sgt++) {
+				driver.sgt(sgt);
+				uint16_t near_stall = load_point(speed, available(speed) * 0.9);
+				uint16_t nominal = load_point(speed, NOMINAL_LOAD);
+				if (near_stall == 0 && nominal >= SG_MARGIN && abs(sgt) < abs(best)) {
+					best = sgt;
+					best_nominal = nominal;
+					best_stall = near_stall;
+				}
+			}
+			check(best != 64, "SGT found for every speed");
+			printf("%u,%d,%u,%u\n", speed, best, best_nominal, best_stall);
+		}
+		sim.run(0);
+	}
+}
+
+int main() {
+	clock_t start = clock();
+	sim.attach(driver);
+	driver.begin();
+	driver.rms_current(600);
+	driver.microsteps(16);
+	driver.TCOOLTHRS(0xFFFFF);
+	digitalWrite(EN_PIN, LOW);
+
+	spi();
+	restore();
+	motor();
+	sweep();
+
+	double s = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("%u load points in %.2fs, %.0f per second\n", scenarios, s, s > 0 ? scenarios / s : 0);
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
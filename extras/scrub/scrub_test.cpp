@@ -0,0 +1,123 @@
+/*
+	Host tests of the register scrubber (TMC2130Stepper::scrub()).
+
+	Registers of a simulated driver are corrupted with poke(), as noise on
+	the SPI lines would:
+	- a clean chip is checked without repairs, one datagram per check
+	- a corrupted CHOPCONF or GCONF is found and rewritten within two
+	  rotations and counted in scrub_mismatches()
+	- write only registers are only rewritten with scrub_refresh(true)
+	- a budget limits the datagrams of one call
+	- after a power cycle scrub() restores the configuration and counts
+	  the reset
+
+	Exits with 1 when a check fails.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/scrub/scrub_test.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o scrub_test
+	./scrub_test
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Sim.h>
+
+#define ROTATION	3	// GCONF, CHOPCONF, XDIRECT
+
+namespace {
+	TMC2130Stepper driver(2, 3, 4, 10);
+	TMC2130Sim sim(2, 3, 4);
+	uint32_t failures = 0;
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+
+	bool matches(uint8_t address) { return sim.peek(address) == driver.shadow(address); }
+
+	// Scrubs until the register matches its shadow again, returns the calls needed
+	uint8_t scrub_until_repaired(uint8_t address) {
+		for (uint8_t calls = 1; calls <= 2 * ROTATION; calls++) {
+			driver.scrub();
+			if (matches(address)) return calls;
+		}
+		return 0xFF;
+	}
+
+	void test_clean() {
+		driver.scrub_clear();
+		uint32_t frames = sim.frames();
+		uint8_t repaired = 0;
+		for (uint8_t i = 0; i < 10 * ROTATION; i++) repaired += driver.scrub();
+		check(repaired == 0, "no repairs on a clean chip");
+		check(driver.scrub_checks() == 10 * ROTATION, "one check per call");
+		check(sim.frames() - frames <= 10 * ROTATION + 1, "one datagram per check");
+		check(driver.scrub_mismatches(REG_GCONF) == 0 && driver.scrub_mismatches(REG_CHOPCONF) == 0, "no mismatches counted");
+	}
+
+	void test_repair() {
+		driver.scrub_clear();
+		sim.poke(REG_CHOPCONF, sim.peek(REG_CHOPCONF) ^ INTPOL_bm);
+		check(!matches(REG_CHOPCONF), "CHOPCONF corrupted");
+		check(scrub_until_repaired(REG_CHOPCONF) <= 2 * ROTATION, "CHOPCONF repaired");
+		check(driver.scrub_mismatches(REG_CHOPCONF) == 1, "CHOPCONF mismatch counted");
+
+		sim.poke(REG_GCONF, sim.peek(REG_GCONF) ^ EN_PWM_MODE_bm);
+		check(scrub_until_repaired(REG_GCONF) <= 2 * ROTATION, "GCONF repaired");
+		check(driver.scrub_mismatches(REG_GCONF) == 1, "GCONF mismatch counted");
+		check(driver.scrub_mismatches(REG_XDIRECT) == 0, "XDIRECT untouched");
+
+		// A further rotation finds nothing, the compared value may be one call old
+		uint8_t repaired = 0;
+		for (uint8_t i = 0; i < 2 * ROTATION; i++) repaired += driver.scrub();
+		check(repaired == 0, "no repairs after the repair");
+		check(driver.scrub_mismatches(REG_CHOPCONF) == 1, "repair counted once");
+
+		driver.scrub_clear();
+		check(driver.scrub_mismatches(REG_CHOPCONF) == 0 && driver.scrub_checks() == 0, "scrub_clear");
+	}
+
+	void test_refresh() {
+		sim.poke(REG_IHOLD_IRUN, 0);
+		driver.scrub(0xFFFF);
+		check(!matches(REG_IHOLD_IRUN), "write only registers left alone by default");
+
+		driver.scrub_refresh(true);
+		driver.scrub(0xFFFF);
+		check(matches(REG_IHOLD_IRUN), "IHOLD_IRUN rewritten with scrub_refresh(true)");
+		driver.scrub_refresh(false);
+
+		uint32_t frames = sim.frames();
+		driver.scrub(3 * sim.frame_us);
+		check(sim.frames() - frames <= 3, "budget limits the datagrams");
+	}
+
+	void test_power_cycle() {
+		uint16_t resets = driver.resets();
+		sim.power_cycle();
+		driver.scrub();
+		check(driver.resets() == resets + 1, "reset counted");
+		check(matches(REG_GCONF) && matches(REG_CHOPCONF) && matches(REG_IHOLD_IRUN), "configuration restored");
+		check(driver.scrub_mismatches(REG_GCONF) == 0 && driver.scrub_mismatches(REG_CHOPCONF) == 0,
+			"a reset is not counted as a mismatch");
+	}
+}
+
+int main() {
+	sim.attach(driver);
+	driver.begin();
+	driver.rms_current(800);
+	driver.microsteps(16);
+	driver.en_pwm_mode(true);
+
+	test_clean();
+	test_repair();
+	test_refresh();
+	test_power_cycle();
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,359 @@
+#include "TMC2130Sim.h"
+#include <TMC2130Stepper_REGMAP.h>
+
+using namespace TMC2130_n;
+
+#define OTPW_C				120.0
+#define OT_C				150.0
+#define STANDSTILL_CLOCKS	(1UL << 20)
+#define TSTEP_MAX			0xFFFFFUL
+
+// Reset values that are not zero
+#define PWMCONF_RESET		0x00050480UL
+
+// Access and implemented bits of every register, from the register map
+#define SIM_REGS(X) \
+	X(GCONF) X(GSTAT) X(IOIN) X(IHOLD_IRUN) X(TPOWERDOWN) X(TSTEP) X(TPWMTHRS) \
+	X(TCOOLTHRS) X(THIGH) X(XDIRECT) X(VDCMIN) X(MSLUT0) X(MSLUT1) X(MSLUT2) \
+	X(MSLUT3) X(MSLUT4) X(MSLUT5) X(MSLUT6) X(MSLUT7) X(MSLUTSEL) X(MSLUTSTART) \
+	X(MSCNT) X(MSCURACT) X(CHOPCONF) X(COOLCONF) X(DCCTRL) X(DRV_STATUS) \
+	X(PWMCONF) X(PWM_SCALE) X(ENCM_CTRL) X(LOST_STEPS)
+
+static uint8_t access(uint8_t address) {
+	switch (address) {
+		#define ACCESS(R) case REG_##R: return R##_r::access;
+		SIM_REGS(ACCESS)
+		#undef ACCESS
+		default: return 0;
+	}
+}
+
+static uint32_t implemented(uint8_t address) {
+	switch (address) {
+		#define MASK(R) case REG_##R: return R##_r::mask;
+		SIM_REGS(MASK)
+		#undef MASK
+		default: return 0;
+	}
+}
+
+TMC2130Sim::TMC2130Sim(uint8_t pinEN, uint8_t pinDIR, uint8_t pinSTEP, uint32_t fclk) {
+	_pinEN = pinEN;
+	_pinDIR = pinDIR;
+	_pinSTEP = pinSTEP;
+	_fclk = fclk;
+	motor.torque = 1.0;
+	motor.load = 0.2;
+	motor.sg_scale = 600;
+	motor.max_fullsteps = 4000;
+	motor.ambient = 25;
+	motor.heating = 60;
+	motor.tau = 30;
+	motor.pwm_offset = 40;
+	motor.pwm_gradient = 50;
+	temp = motor.ambient;
+	power_cycle();
+}
+
+// Routes the driver's datagrams and pins to this model
+void TMC2130Sim::attach(TMC2130Stepper &driver) {
+	driver.bus_backend(bus, this);
+	prev_hook = host_gpio_hook(gpio, this, &prev_ctx);
+	last_update = micros();
+}
+
+// Pins the DIAG outputs are driven on, 0xFF for not connected
+void TMC2130Sim::diag_pins(uint8_t pinDIAG0, uint8_t pinDIAG1) {
+	_pinDIAG[0] = pinDIAG0;
+	_pinDIAG[1] = pinDIAG1;
+	diag_level[0] = diag_level[1] = 0xFF;
+	outputs();
+}
+
+void TMC2130Sim::power_cycle() {
+	memset(regs, 0, sizeof(regs));
+	regs[REG_PWMCONF] = PWMCONF_RESET;
+	gstat = RESET_bm;
+	latch = 0;
+	cs = 0;
+	sg = 0;
+	stall = false;
+	ot = false;
+	faults = 0;
+	mscnt = 0;
+	outputs();
+}
+
+void TMC2130Sim::fault(uint32_t drv_status_bits) {
+	faults = drv_status_bits & (S2GA_bm|S2GB_bm|OLA_bm|OLB_bm);
+	if (faults & (S2GA_bm|S2GB_bm)) gstat |= DRV_ERR_bm;
+	outputs();
+}
+
+void TMC2130Sim::bus(void *ctx, uint8_t *d) { static_cast<TMC2130Sim*>(ctx)->datagram(d); }
+
+/*
+	The reply carries the status byte of this datagram and the register
+	addressed by the previous one. The latch is loaded after a write too,
+	so a write followed by a read returns the written register, or zero
+	for write only registers.
+*/
+void TMC2130Sim::datagram(uint8_t *d) {
+	uint8_t req[5];
+	memcpy(req, d, sizeof(req));
+	host_advance(frame_us);
+	response(d);
+	request(req);
+}
+
+// First half of a datagram, when CS goes low: the bits to shift out
+void TMC2130Sim::response(uint8_t *d) {
+	update();
+	d[0] = status();
+	d[1] = latch >> 24;
+	d[2] = latch >> 16;
+	d[3] = latch >> 8;
+	d[4] = latch;
+}
+
+// Second half, when CS goes high: the 40 bits received
+void TMC2130Sim::request(const uint8_t *d) {
+	_frames++;
+	uint8_t address = d[0] & 0x7F;
+	bool write_access = d[0] & 0x80;
+	uint32_t data = (uint32_t)d[1] << 24 | (uint32_t)d[2] << 16 | (uint32_t)d[3] << 8 | d[4];
+
+	if (write_access) write(address, data);
+	latch = read(address);
+	if (!write_access && address == REG_GSTAT) gstat = 0;
+	if (write_access) outputs();
+}
+
+void TMC2130Sim::write(uint8_t address, uint32_t value) {
+	if (!(access(address) & W)) return;
+	if (address == REG_GSTAT) gstat &= ~value;
+	else regs[address] = value & implemented(address);
+}
+
+uint32_t TMC2130Sim::read(uint8_t address) {
+	if (!(access(address) & R)) return 0;
+	switch (address) {
+		case REG_GSTAT: 	return gstat;
+		case REG_IOIN:
+			return	(uint32_t)0x11 << VERSION_bp |
+					(digitalRead(_pinSTEP) ? STEP_bm : 0) |
+					(digitalRead(_pinDIR) ? DIR_bm : 0) |
+					(digitalRead(_pinEN) ? DRV_ENN_CFG6_bm : 0);
+		case REG_TSTEP: 	return tstep();
+		case REG_MSCNT: 	return mscnt;
+		case REG_MSCURACT: {
+			float phase = mscnt * (2*M_PI/1024);
+			int16_t a = lroundf(248 * sinf(phase));
+			int16_t b = lroundf(248 * cosf(phase));
+			return CUR_B_f::set(CUR_A_f::set(0, a), b);
+		}
+		case REG_DRV_STATUS: return drv_status();
+		case REG_PWM_SCALE: {
+			uint32_t pwmconf = regs[REG_PWMCONF];
+			if (!PWM_AUTOSCALE_f::get(pwmconf))
+				return min(255, PWM_AMPL_f::get(pwmconf) + PWM_GRAD_f::get(pwmconf) * fullsteps() / 1000);
+			float scale = motor.pwm_offset * (cs+1) / 32 + motor.pwm_gradient * fullsteps() / 1000;
+			return min(255.0f, scale);
+		}
+		case REG_LOST_STEPS: return 0; // dcStep is not modelled
+		default: 			return regs[address];
+	}
+}
+
+void TMC2130Sim::poke(uint8_t address, uint32_t value) {
+	address &= 0x7F;
+	regs[address] = value & implemented(address);
+	outputs();
+}
+
+uint32_t TMC2130Sim::peek(uint8_t address) {
+	address &= 0x7F;
+	return (access(address) & R) ? read(address) : regs[address];
+}
+
+uint8_t TMC2130Sim::status() {
+	uint32_t drv = drv_status();
+	return	(gstat & RESET_bm ? STATUS_RESET_bm : 0) |
+			(gstat & DRV_ERR_bm ? STATUS_DRV_ERR_bm : 0) |
+			(drv & STALLGUARD_bm ? STATUS_SG2_bm : 0) |
+			(drv & STST_bm ? STATUS_STANDSTILL_bm : 0);
+}
+
+uint32_t TMC2130Sim::drv_status() {
+	uint32_t drv = SG_RESULT_f::set(0, sg) | CS_ACTUAL_f::set(0, cs) | faults;
+	if (stall) drv |= STALLGUARD_bm;
+	if (ot) drv |= OT_bm;
+	if (temp >= OTPW_C) drv |= OTPW_bm;
+	if (standstill()) drv |= STST_bm;
+	return drv;
+}
+
+void TMC2130Sim::gpio(void *ctx, uint8_t pin, uint8_t value) {
+	TMC2130Sim *sim = static_cast<TMC2130Sim*>(ctx);
+	if (sim->prev_hook) sim->prev_hook(sim->prev_ctx, pin, value);
+	if (pin != sim->_pinSTEP) return;
+	value = value ? HIGH : LOW;
+	bool edge = value != sim->step_level;
+	sim->step_level = value;
+	// Rising edges only, unless double edge stepping is enabled
+	if (edge && (value == HIGH || DEDGE_f::get(sim->regs[REG_CHOPCONF]))) sim->on_step();
+}
+
+void TMC2130Sim::step(uint32_t count, uint32_t interval_us) {
+	while (count--) {
+		host_advance(interval_us);
+		on_step();
+	}
+	update();
+}
+
+void TMC2130Sim::on_step() {
+	update();
+	step_at(host_state().time_us);
+}
+
+// Steps continuously from update(), so the motor keeps moving through delay()
+void TMC2130Sim::run(float steps_per_s) {
+	update();
+	run_period = steps_per_s > 0 ? 1e6 / steps_per_s + 0.5 : 0;
+	next_step = host_state().time_us;
+}
+
+void TMC2130Sim::step_at(uint32_t t) {
+	if (!enabled()) return;
+	if (stepped) step_interval = t - last_step;
+	stepped = true;
+	last_step = t;
+
+	int16_t inc = 1 << MRES_f::get(regs[REG_CHOPCONF]);
+	if (!digitalRead(_pinDIR) != !SHAFT_f::get(regs[REG_GCONF])) inc = -inc;
+	_position += inc;
+	mscnt = (mscnt + inc) & 0x3FF;
+
+	// The first steps at a new speed are taken before update() sees it
+	update();
+	if (stall) lost++;
+	else _rotor += inc;
+}
+
+uint32_t TMC2130Sim::clocks(uint32_t us) {
+	uint64_t c = (uint64_t)us * _fclk / 1000000;
+	return c > 0xFFFFFFFFUL ? 0xFFFFFFFFUL : c;
+}
+
+bool TMC2130Sim::standstill() {
+	return !stepped || clocks(host_state().time_us - last_step) >= STANDSTILL_CLOCKS;
+}
+
+// Clocks per 1/256 microstep of the last step interval, or of the time
+// since the last step when that is longer
+uint32_t TMC2130Sim::tstep() {
+	if (standstill() || !step_interval) return TSTEP_MAX;
+	uint32_t us = max(step_interval, host_state().time_us - last_step);
+	uint32_t t = clocks(us) >> MRES_f::get(regs[REG_CHOPCONF]);
+	return min(t, TSTEP_MAX);
+}
+
+float TMC2130Sim::fullsteps() {
+	uint32_t t = tstep();
+	if (t >= TSTEP_MAX || !t) return 0;
+	return (float)_fclk / t / 256;
+}
+
+bool TMC2130Sim::enabled() {
+	return !digitalRead(_pinEN) && TOFF_f::get(regs[REG_CHOPCONF]) && !ot;
+}
+
+// One current adjustment per update while the velocity is inside the coolStep window
+void TMC2130Sim::coolstep() {
+	uint32_t coolconf = regs[REG_COOLCONF];
+	uint8_t irun = IRUN_f::get(regs[REG_IHOLD_IRUN]);
+	uint8_t semin = SEMIN_f::get(coolconf);
+	uint32_t t = tstep();
+	if (!semin || t > regs[REG_TCOOLTHRS] || t <= regs[REG_THIGH]) {
+		cs = irun;
+		return;
+	}
+	uint8_t lower = SEIMIN_f::get(coolconf) ? (irun+1)/4 - 1 : (irun+1)/2 - 1;
+	if (sg < semin * 32U) {
+		cs = min((uint16_t)irun, cs + (1 << SEUP_f::get(coolconf)));
+	} else if (sg >= (semin + SEMAX_f::get(coolconf) + 1) * 32U && cs > lower) {
+		cs--;
+	}
+	cs = constrain(cs, lower, irun);
+}
+
+void TMC2130Sim::update() {
+	uint32_t now = host_state().time_us;
+	if (run_period && !generating) {
+		generating = true;
+		while ((int32_t)(now - next_step) >= 0) {
+			step_at(next_step);
+			next_step += run_period;
+		}
+		generating = false;
+	}
+	float dt = (now - last_update) * 1e-6;
+	last_update = now;
+
+	bool on = enabled();
+	if (!on) {
+		cs = 0;
+		stall = false;
+	} else if (standstill()) {
+		uint32_t idle = clocks(now - last_step);
+		uint32_t delay = (uint32_t)TPOWERDOWN_f::get(regs[REG_TPOWERDOWN]) << 18;
+		if (!stepped || idle >= delay) cs = IHOLD_f::get(regs[REG_IHOLD_IRUN]);
+		else cs = IRUN_f::get(regs[REG_IHOLD_IRUN]);
+		stall = false;
+	} else {
+		coolstep();
+		float v = fullsteps();
+		float torque = motor.torque * (cs+1) / 32 * max(0.0f, 1 - v / motor.max_fullsteps);
+		float r = torque > 0 ? min(1.0f, motor.load / torque) : 1.0f;
+		stall = motor.load >= torque;
+		int16_t s = stall ? 0 : motor.sg_scale * (1 - r) + 32 * SGT_f::get(regs[REG_COOLCONF]);
+		sg = constrain(s, 0, 1023);
+	}
+
+	float level = on ? (cs+1) / 32.0f : 0;
+	float target = motor.ambient + motor.heating * level * level;
+	temp += (target - temp) * (1 - expf(-dt / motor.tau));
+	if (temp >= OT_C) ot = true;
+	// Overtemperature shutdown is latched until the driver is disabled and cooled down
+	if (ot && temp < OTPW_C && (digitalRead(_pinEN) || !TOFF_f::get(regs[REG_CHOPCONF]))) ot = false;
+	outputs();
+}
+
+void TMC2130Sim::outputs() {
+	uint32_t gconf = regs[REG_GCONF];
+	uint32_t drv = drv_status();
+	bool active[2];
+	active[0] =	((gconf & DIAG0_ERROR_bm) && (drv & (OT_bm|S2GA_bm|S2GB_bm))) ||
+				((gconf & DIAG0_OTPW_bm) && (drv & OTPW_bm)) ||
+				((gconf & DIAG0_STALL_bm) && stall);
+	active[1] =	((gconf & DIAG1_STALL_bm) && stall) ||
+				((gconf & DIAG1_INDEX_bm) && mscnt == 0);
+	bool pushpull[2] = { (gconf & DIAG0_INT_PUSHPULL_bm) != 0, (gconf & DIAG1_PUSHPULL_bm) != 0 };
+
+	for (uint8_t i = 0; i < 2; i++) {
+		if (_pinDIAG[i] == 0xFF) continue;
+		// Push-pull outputs are active high, open drain outputs pull low
+		uint8_t level = active[i] == pushpull[i] ? HIGH : LOW;
+		if (level == diag_level[i]) continue;
+		diag_level[i] = level;
+		digitalWrite(_pinDIAG[i], level);
+	}
+}
+
+int32_t TMC2130Sim::position() 		{ return _position; }
+int32_t TMC2130Sim::rotor() 		{ return _rotor; }
+uint32_t TMC2130Sim::lost_steps() 	{ return lost; }
+bool TMC2130Sim::stalled() 			{ return stall; }
+float TMC2130Sim::temperature() 	{ return temp; }
+uint32_t TMC2130Sim::frames() 		{ return _frames; }
@@ -0,0 +1,132 @@
+#ifndef TMC2130Sim_h
+#define TMC2130Sim_h
+
+#include <TMC2130Stepper.h>
+
+#ifdef ARDUINO
+	#error "TMC2130Sim is for host builds only"
+#endif
+
+/*
+	Behavioural model of a TMC2130 and the motor behind it, for running
+	library code and tuning algorithms on a PC.
+
+	Build together with the library on the host, e.g.
+
+	g++ -std=gnu++11 -Isrc -Iextras/simulator test.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp
+
+	SPI datagrams follow the datasheet:
+	- the reply to a read request arrives with the next datagram
+	- write only registers read back as zero
+	- GSTAT is cleared by reading it and by writing 1
+	- the status byte carries reset, drv_err, stallGuard and standstill
+	- power_cycle() returns all registers to their reset values
+	  and sets GSTAT.reset
+
+	The motor model is deliberately simple. Available torque scales with
+	the actual current and falls linearly to zero at max_fullsteps.
+	SG_RESULT falls with the load ratio and is shifted by SGT. The motor
+	stalls when the load exceeds the available torque, and steps are then
+	lost. coolStep adapts CS_ACTUAL between the SEMIN and SEMAX limits.
+	The die temperature follows the coil current with a first order lag
+	and trips OTPW at 120C and OT at 150C.
+
+	The DIAG0/DIAG1 outputs follow the GCONF routing once diag_pins() is
+	set: errors, OTPW and stall on DIAG0, stall and the index position
+	(MSCNT=0) on DIAG1. Open drain outputs idle high, as with a pull-up.
+
+	Steps are taken from the STEP pin through the host pin hook, issued
+	directly with step(), or generated at a constant rate with run().
+	Time is the host virtual clock. Every datagram advances it by
+	frame_us.
+*/
+
+struct TMC2130_sim_motor_t {
+	float torque;			// Holding torque at full current (CS=31)
+	float load;				// Load torque, same unit as torque
+	float sg_scale;			// SG_RESULT without load at SGT=0
+	float max_fullsteps;	// Fullsteps/s where the available torque reaches zero
+	float ambient;			// C
+	float heating;			// Temperature rise at full current, C
+	float tau;				// Thermal time constant, s
+	float pwm_offset;		// PWM_SCALE at standstill with full current
+	float pwm_gradient;		// PWM_SCALE increase per 1000 fullsteps/s
+};
+
+class TMC2130Sim {
+	public:
+		TMC2130Sim(uint8_t pinEN, uint8_t pinDIR, uint8_t pinSTEP, uint32_t fclk=12000000);
+		void attach(TMC2130Stepper &driver);
+		void diag_pins(uint8_t pinDIAG0, uint8_t pinDIAG1=0xFF);
+		void datagram(uint8_t *d);
+		void response(uint8_t *d);
+		void request(const uint8_t *d);
+		static void bus(void *ctx, uint8_t *d);
+		void step(uint32_t count=1, uint32_t interval_us=0);
+		void run(float steps_per_s);
+		void power_cycle();
+		void fault(uint32_t drv_status_bits);
+		void update();
+
+		uint32_t peek(uint8_t address);
+		void poke(uint8_t address, uint32_t value);	// Corrupt a register, e.g. to simulate noise
+		int32_t position();		// Commanded position, 1/256 microsteps
+		int32_t rotor();		// Position the rotor followed, 1/256 microsteps
+		uint32_t lost_steps();	// Step pulses lost while stalled
+		bool stalled();
+		float temperature();
+		uint32_t frames();
+
+		TMC2130_sim_motor_t motor;
+		uint16_t frame_us = 20;	// 40 bits at 2MHz
+
+	private:
+		static void gpio(void *ctx, uint8_t pin, uint8_t value);
+		void on_step();
+		void step_at(uint32_t t);
+		uint32_t read(uint8_t address);
+		void write(uint8_t address, uint32_t value);
+		uint8_t status();
+		uint32_t drv_status();
+		uint32_t clocks(uint32_t us);
+		uint32_t tstep();
+		bool standstill();
+		bool enabled();
+		float fullsteps();
+		void coolstep();
+		void outputs();
+
+		uint8_t _pinEN, _pinDIR, _pinSTEP;
+		uint8_t _pinDIAG[2] = {0xFF, 0xFF};
+		uint8_t diag_level[2] = {0xFF, 0xFF};	// Last level driven, 0xFF = none yet
+		uint32_t _fclk;
+		host_gpio_hook_t prev_hook = NULL;
+		void *prev_ctx = NULL;
+
+		uint32_t regs[0x80];
+		uint8_t gstat;
+		uint32_t latch = 0;
+		uint32_t _frames = 0;
+		uint32_t faults = 0;
+
+		int32_t _position = 0;
+		int32_t _rotor = 0;
+		uint32_t lost = 0;
+		uint16_t mscnt = 0;
+		uint8_t step_level = LOW;
+		bool stepped = false;		// At least one step since power up
+		uint32_t last_step = 0;		// us
+		uint32_t step_interval = 0;	// us between the last two steps
+		uint32_t last_update = 0;
+		uint32_t run_period = 0;	// us per step for run(), 0 = stopped
+		uint32_t next_step = 0;
+		bool generating = false;
+		uint8_t cs = 0;
+		uint16_t sg = 0;
+		bool stall = false;
+		bool ot = false;
+		float temp;
+};
+
+#endif
@@ -0,0 +1,60 @@
+#include "TMC2130SimSPI.h"
+
+TMC2130SimSPI::TMC2130SimSPI(TMC2130Sim &sim, uint8_t pinCS, uint8_t pinSCK, uint8_t pinMOSI, uint8_t pinMISO) :
+	_sim(sim), _pinCS(pinCS), _pinSCK(pinSCK), _pinMOSI(pinMOSI), _pinMISO(pinMISO) {}
+
+void TMC2130SimSPI::attach() {
+	prev_hook = host_gpio_hook(gpio, this, &prev_ctx);
+	cs = digitalRead(_pinCS);
+	sck = digitalRead(_pinSCK);
+	mosi = digitalRead(_pinMOSI);
+}
+
+void TMC2130SimSPI::gpio(void *ctx, uint8_t pin, uint8_t value) {
+	TMC2130SimSPI *spi = static_cast<TMC2130SimSPI*>(ctx);
+	if (spi->prev_hook) spi->prev_hook(spi->prev_ctx, pin, value);
+	spi->pin_changed(pin, value ? HIGH : LOW);
+}
+
+// Mode 3: the slave shifts out on the falling edge and samples on the rising edge
+void TMC2130SimSPI::pin_changed(uint8_t pin, uint8_t value) {
+	if (pin == _pinCS && value != cs) {
+		cs = value;
+		if (cs == LOW) {
+			if (sck != HIGH) _mode_errors++;
+			bits = 0;
+			memset(rx, 0, sizeof(rx));
+			_sim.response(tx);
+		} else {
+			if (bits == 40) {
+				_sim.request(rx);
+				_frames++;
+			} else {
+				_framing_errors++;
+			}
+		}
+	} else if (pin == _pinSCK && value != sck) {
+		sck = value;
+		if (cs == HIGH) return;
+		if (sck == LOW) {
+			output_bit();
+		} else {
+			if (bits < 40 && mosi) rx[bits/8] |= 0x80 >> (bits%8);
+			bits++;
+			_edges++;
+		}
+	} else if (pin == _pinMOSI && value != mosi) {
+		mosi = value;
+		if (cs == LOW && sck == HIGH) _mode_errors++;
+	}
+}
+
+void TMC2130SimSPI::output_bit() {
+	if (bits >= 40) return;
+	digitalWrite(_pinMISO, (tx[bits/8] << (bits%8)) & 0x80 ? HIGH : LOW);
+}
+
+uint32_t TMC2130SimSPI::frames() 			{ return _frames; }
+uint32_t TMC2130SimSPI::mode_errors() 		{ return _mode_errors; }
+uint32_t TMC2130SimSPI::framing_errors() 	{ return _framing_errors; }
+uint32_t TMC2130SimSPI::edges() 			{ return _edges; }
@@ -0,0 +1,48 @@
+#ifndef TMC2130SimSPI_h
+#define TMC2130SimSPI_h
+
+#include "TMC2130Sim.h"
+
+/*
+	Pin level SPI slave in front of a TMC2130Sim, for checking software
+	SPI waveforms on the host. It follows CS, SCK and MOSI through the
+	host pin hook and drives MISO.
+
+	Protocol errors are counted instead of asserted:
+	- mode: SCK not idle high when CS falls, or MOSI changing while
+	  SCK is high
+	- framing: CS rising after a number of bits other than 40
+
+	Attach the simulator to the driver first and the software SPI after
+	it, so the driver's bus backend is the software SPI:
+
+	sim.attach(driver);
+	slave.attach();
+	bus.attach(driver, CS_PIN);
+*/
+class TMC2130SimSPI {
+	public:
+		TMC2130SimSPI(TMC2130Sim &sim, uint8_t pinCS, uint8_t pinSCK, uint8_t pinMOSI, uint8_t pinMISO);
+		void attach();
+		uint32_t frames();
+		uint32_t mode_errors();
+		uint32_t framing_errors();
+		uint32_t edges();	// Rising SCK edges while selected
+
+	private:
+		static void gpio(void *ctx, uint8_t pin, uint8_t value);
+		void pin_changed(uint8_t pin, uint8_t value);
+		void output_bit();
+
+		TMC2130Sim &_sim;
+		uint8_t _pinCS, _pinSCK, _pinMOSI, _pinMISO;
+		host_gpio_hook_t prev_hook = NULL;
+		void *prev_ctx = NULL;
+
+		uint8_t cs = HIGH, sck = HIGH, mosi = LOW;
+		uint8_t tx[5], rx[5];
+		uint8_t bits = 0;
+		uint32_t _frames = 0, _mode_errors = 0, _framing_errors = 0, _edges = 0;
+};
+
+#endif
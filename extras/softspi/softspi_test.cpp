@@ -0,0 +1,140 @@
+/*
+	Host tests of the bit-banged SPI (TMC2130SoftSPI).
+
+	Two simulated drivers are attached to one software SPI bus, each
+	behind a pin level slave (TMC2130SimSPI) that checks the waveform:
+	- register writes and reads go through transfer() on each channel
+	- read_all() returns the register of every channel from two
+	  datagrams per channel, clocked out through transfer_all()
+	- all datagrams are mode 3 and 40 bits long
+	- the drivers use the bus' own arbiter, and read_all() does not
+	  clock while it is taken
+	- read_all() refuses channels sharing a MOSI or MISO pin
+
+	Exits with 1 when a check fails.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/softspi/softspi_test.cpp \
+		extras/simulator/TMC2130Sim.cpp extras/simulator/TMC2130SimSPI.cpp src/source/[A-Z]*.cpp -o softspi_test
+	./softspi_test
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Stepper_SOFTSPI.h>
+#include <TMC2130Sim.h>
+#include <TMC2130SimSPI.h>
+
+#define PIN_SCK		13
+#define PIN_MOSI_X	20
+#define PIN_MISO_X	21
+#define PIN_MOSI_Y	22
+#define PIN_MISO_Y	23
+#define CS_X		10
+#define CS_Y		11
+
+namespace {
+	TMC2130Stepper driver_x(2, 3, 4, CS_X);
+	TMC2130Stepper driver_y(5, 6, 7, CS_Y);
+	TMC2130Sim sim_x(2, 3, 4);
+	TMC2130Sim sim_y(5, 6, 7);
+	TMC2130SimSPI slave_x(sim_x, CS_X, PIN_SCK, PIN_MOSI_X, PIN_MISO_X);
+	TMC2130SimSPI slave_y(sim_y, CS_Y, PIN_SCK, PIN_MOSI_Y, PIN_MISO_Y);
+	TMC2130SoftSPI bus(PIN_SCK, PIN_MOSI_X, PIN_MISO_X);
+	uint32_t failures = 0;
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+
+	// Every datagram the simulators saw came through the pins, without protocol errors
+	void check_waveform(const char *when) {
+		char what[64];
+		snprintf(what, sizeof(what), "waveform %s", when);
+		check(slave_x.mode_errors() == 0 && slave_y.mode_errors() == 0, what);
+		check(slave_x.framing_errors() == 0 && slave_y.framing_errors() == 0, what);
+		check(slave_x.frames() == sim_x.frames() && slave_y.frames() == sim_y.frames(), what);
+		check(slave_x.edges() == 40 * slave_x.frames() && slave_y.edges() == 40 * slave_y.frames(), what);
+	}
+
+	void test_channels() {
+		uint32_t frames_x = slave_x.frames(), frames_y = slave_y.frames();
+		driver_x.CHOPCONF(0x04028008);
+		driver_y.CHOPCONF(0x06018004);
+		check(slave_x.frames() - frames_x == 1 && slave_y.frames() - frames_y == 1, "one datagram per write");
+		check(sim_x.peek(REG_CHOPCONF) == 0x04028008, "write on channel 0");
+		check(sim_y.peek(REG_CHOPCONF) == 0x06018004, "write on channel 1");
+
+		frames_x = slave_x.frames();
+		frames_y = slave_y.frames();
+		check(driver_x.CHOPCONF() == 0x04028008, "read back on channel 0");
+		check(driver_y.CHOPCONF() == 0x06018004, "read back on channel 1");
+		check(slave_x.frames() - frames_x == 2 && slave_y.frames() - frames_y == 2, "two datagrams per read");
+		check(driver_x.version() == 0x11 && driver_y.version() == 0x11, "IOIN version");
+		check_waveform("of single transfers");
+	}
+
+	void test_read_all() {
+		uint32_t v[2];
+		uint32_t frames_x = slave_x.frames(), frames_y = slave_y.frames();
+		check(bus.read_all(REG_CHOPCONF, v), "read_all CHOPCONF");
+		check(v[0] == 0x04028008 && v[1] == 0x06018004, "read_all CHOPCONF values");
+		check(bus.read_all(REG_IOIN, v), "read_all IOIN");
+		check(v[0] == sim_x.peek(REG_IOIN) && v[1] == sim_y.peek(REG_IOIN), "read_all IOIN values");
+		check(slave_x.frames() - frames_x == 4 && slave_y.frames() - frames_y == 4, "two datagrams per read_all");
+		check_waveform("of read_all");
+
+		// The drivers' pipelines were resynchronised, single reads still line up
+		check(driver_x.CHOPCONF() == 0x04028008 && driver_y.CHOPCONF() == 0x06018004, "read after read_all");
+	}
+
+	void test_arbiter() {
+		check(&driver_x.bus_arbiter() == &bus.bus_arbiter(), "channel 0 uses the bus' arbiter");
+		check(&driver_y.bus_arbiter() == &bus.bus_arbiter(), "channel 1 uses the bus' arbiter");
+		check(&bus.bus_arbiter() != &TMC2130Bus::spi, "bus arbiter is not the hardware SPI's");
+
+		uint32_t v[2];
+		uint32_t frames_x = slave_x.frames();
+		check(bus.bus_arbiter().acquire(), "acquire");
+		check(!bus.read_all(REG_IOIN, v), "read_all with the bus taken");
+		bus.bus_arbiter().release();
+		check(slave_x.frames() == frames_x, "no datagram with the bus taken");
+		check(!bus.bus_arbiter().busy(), "read_all releases the arbiter");
+		check(bus.read_all(REG_IOIN, v), "read_all after release");
+		check(!bus.bus_arbiter().busy(), "arbiter free after read_all");
+	}
+
+	// Channels on the constructor's MOSI and MISO pins share them
+	void test_shared_pins() {
+		TMC2130SoftSPI shared(PIN_SCK, PIN_MOSI_X, PIN_MISO_X);
+		shared.attach(driver_x, CS_X);
+		shared.attach(driver_y, CS_Y);
+		uint32_t v[2];
+		uint32_t frames_x = slave_x.frames(), frames_y = slave_y.frames();
+		check(!shared.read_all(REG_IOIN, v), "read_all refuses shared pins");
+		check(slave_x.frames() == frames_x && slave_y.frames() == frames_y, "no datagram on shared pins");
+		check(!shared.bus_arbiter().busy(), "refusal leaves the arbiter free");
+	}
+}
+
+int main() {
+	sim_x.attach(driver_x);
+	sim_y.attach(driver_y);
+	slave_x.attach();
+	slave_y.attach();
+	check(bus.attach(driver_x, CS_X) == 0, "attach channel 0");
+	check(bus.attach(driver_y, CS_Y, PIN_MOSI_Y, PIN_MISO_Y) == 1, "attach channel 1");
+	driver_x.begin();
+	driver_y.begin();
+	check_waveform("of begin()");
+
+	test_channels();
+	test_read_all();
+	test_arbiter();
+	test_shared_pins();
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,119 @@
+/*
+	Host tests of the standstill current policy (TMC2130Standstill).
+
+	Two simulated drivers are run against a simulated millisecond clock:
+	- the hold, reduced and off stages start at the configured idle times
+	  and set IHOLD and the freewheel mode in the driver
+	- wake() restores the hold current with at most two datagrams
+	- an axis kept moving is not reduced
+	- the energy estimate follows I_rms^2 * R * t for both coils
+	- idle times are measured across the wrap of the clock
+
+	Exits with 1 when a check fails.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/standstill/standstill_test.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o standstill_test
+	./standstill_test
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Stepper_STANDSTILL.h>
+#include <TMC2130Sim.h>
+#include <math.h>
+
+#define R_COIL		1.65
+#define REDUCE_MS	10000
+#define OFF_MS		30000
+
+namespace {
+	TMC2130Stepper driver_a(2, 3, 4, 10);
+	TMC2130Stepper driver_b(5, 6, 7, 11);
+	TMC2130Sim sim_a(2, 3, 4);
+	TMC2130Sim sim_b(5, 6, 7);
+	uint32_t failures = 0;
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		failures++;
+	}
+
+	uint8_t ihold(TMC2130Sim &sim) 		{ return TMC2130_n::IHOLD_f::get(sim.peek(REG_IHOLD_IRUN)); }
+	uint8_t freewheel(TMC2130Sim &sim) 	{ return TMC2130_n::FREEWHEEL_f::get(sim.peek(REG_PWMCONF)); }
+
+	float I_rms(TMC2130Stepper &d, uint8_t cs) {
+		return (cs+1) / 32.0 * (d.vsense() ? 0.180 : 0.325) / (d.Rsense + 0.02) / sqrt(2);
+	}
+
+	// Runs update() once per 100ms from `from` to `to`, with axis b moving
+	void run(TMC2130Standstill &policy, uint32_t from, uint32_t to) {
+		for (uint32_t t = from; t != to; t += 100) {
+			policy.moved(1, t);
+			policy.update(t);
+		}
+	}
+
+	void test_stages(uint32_t start) {
+		TMC2130Standstill policy(REDUCE_MS, 50, OFF_MS);
+		policy.freewheel(2);
+		check(policy.add(driver_a, R_COIL, 128, 6, start), "add a");
+		check(policy.add(driver_b, R_COIL, 128, 6, start), "add b");
+		uint8_t nominal = driver_a.ihold();
+
+		run(policy, start, start + REDUCE_MS - 100);
+		check(policy.stage(0) == STANDSTILL_HOLD && ihold(sim_a) == nominal, "hold before reduce_ms");
+		run(policy, start + REDUCE_MS - 100, start + REDUCE_MS + 100);
+		check(policy.stage(0) == STANDSTILL_REDUCED && ihold(sim_a) == nominal / 2, "reduced after reduce_ms");
+		check(policy.stage(1) == STANDSTILL_HOLD && ihold(sim_b) == nominal, "moving axis is not reduced");
+
+		run(policy, start + REDUCE_MS + 100, start + OFF_MS + 100);
+		check(policy.stage(0) == STANDSTILL_OFF && ihold(sim_a) == 0 && freewheel(sim_a) == 2, "off after off_ms");
+		check(policy.idle_time(0, start + OFF_MS + 100) == OFF_MS + 100, "idle time");
+
+		uint32_t frames = sim_a.frames();
+		policy.wake(0, start + OFF_MS + 200);
+		check(sim_a.frames() - frames <= 2, "wake in two datagrams");
+		check(policy.stage(0) == STANDSTILL_MOVING && ihold(sim_a) == nominal && freewheel(sim_a) == 0, "wake restores");
+
+		policy.update(start + OFF_MS + 300);
+		check(policy.stage(0) == STANDSTILL_HOLD, "hold after the move");
+	}
+
+	void test_energy() {
+		TMC2130Standstill policy(0, 50, 0);
+		policy.add(driver_a, R_COIL, 128, 6, 0);
+		policy.add(driver_b, R_COIL, 128, 6, 0);
+		run(policy, 0, 10000);
+
+		float run_j = 2 * pow(I_rms(driver_b, driver_b.irun()), 2) * R_COIL * 9.9;
+		check(fabs(policy.energy(1) - run_j) < 0.01 * run_j, "energy while moving");
+		// Axis a sits at the run current until TPOWERDOWN expires, then at the hold current
+		float hold_j = 2 * pow(I_rms(driver_a, driver_a.ihold()), 2) * R_COIL * 9.9;
+		check(policy.energy(0) > hold_j && policy.energy(0) < run_j, "energy at hold current");
+		policy.clear_energy();
+		check(policy.energy(0) == 0 && policy.energy(1) == 0, "clear_energy");
+	}
+}
+
+int main() {
+	sim_a.attach(driver_a);
+	sim_b.attach(driver_b);
+	driver_a.begin();
+	driver_b.begin();
+	driver_a.rms_current(800);
+	driver_b.rms_current(800);
+	driver_a.stealthChop(1);
+
+	test_stages(0);
+	test_stages(0xFFFFFFFF - REDUCE_MS);	// The clock wraps between the stages
+	test_energy();
+
+	TMC2130Standstill full;
+	for (uint8_t i = 0; i < TMC2130_STANDSTILL_MAX_DRIVERS; i++) full.add(driver_a, 0, 128, 6, 0);
+	check(!full.add(driver_b, 0, 128, 6, 0), "add beyond TMC2130_STANDSTILL_MAX_DRIVERS");
+
+	printf("%s: %u failures\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,142 @@
+/*
+	Measures the XDIRECT streaming rate (stream_begin()/stream_tick()) on
+	the host.
+
+	A simulated timer interrupt calls stream_tick() every tick_us of host
+	virtual time. The simulated driver advances the clock by the duration
+	of each 40 bit datagram at the SPI clock under test, plus a fixed
+	overhead per datagram for chip select and the library code. An
+	interrupt that is still running when the next one is due fires again
+	right after it returns, like a pending timer flag. Several missed ticks
+	give one pending interrupt.
+
+	For every SPI clock the sample period is lowered 1us at a time until
+	samples come late. The last period without late samples is the
+	achievable update rate. Every XDIRECT value reaching the driver is
+	checked against the buffer, so a skipped or repeated sample counts
+	as a mismatch. Before that, stream_begin() and stream_end() are checked
+	to restore the direct_mode from before the stream, also when a stream
+	is restarted or ended twice. Exits with 1 on a mismatch.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/stream/stream_rate.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o stream_rate
+	./stream_rate [overhead_us] [tick_us]
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Sim.h>
+#include <math.h>
+
+#define SAMPLES 	1000
+#define BUFFER 		64
+
+namespace {
+	TMC2130Stepper driver(2, 3, 4, 10);
+	TMC2130Sim sim(2, 3, 4);
+	uint32_t wave[BUFFER];
+	uint32_t overhead_us = 4;
+	uint16_t expected = 0;		// Next buffer entry the driver must see
+	uint32_t mismatches = 0;
+
+	// Chip select, SPI setup and library code around each datagram
+	void backend(void *ctx, uint8_t *d) {
+		host_advance(overhead_us);
+		if (d[0] == (TMC2130_WRITE|REG_XDIRECT) && driver.streaming()) {
+			uint32_t value = (uint32_t)d[1] << 24 | (uint32_t)d[2] << 16 | (uint32_t)d[3] << 8 | d[4];
+			if (value != wave[expected]) mismatches++;
+			expected = (expected + 1) % BUFFER;
+		}
+		static_cast<TMC2130Sim*>(ctx)->datagram(d);
+	}
+
+	// Runs the timer until SAMPLES samples were written at period_us
+	TMC2130_stream_stats_t run(uint32_t period_us, uint32_t tick_us) {
+		expected = 0;
+		driver.stream_begin(wave, BUFFER, period_us);
+		uint32_t next = micros();
+		while (driver.stream_stats().samples < SAMPLES) {
+			uint32_t now = micros();
+			if ((int32_t)(next - now) > 0) host_advance(next - now);
+			else next += (now - next) / tick_us * tick_us; // Ticks missed while busy merge into the pending one
+			next += tick_us;
+			driver.stream_tick();	// The timer interrupt
+		}
+		TMC2130_stream_stats_t stats = driver.stream_stats();
+		driver.stream_end();
+		return stats;
+	}
+
+	void check(bool ok, const char *what) {
+		if (ok) return;
+		printf("FAIL: %s\n", what);
+		mismatches++;
+	}
+
+	bool direct() { return driver.direct_mode() && (sim.peek(REG_GCONF) & DIRECT_MODE_bm); }
+
+	void check_begin_end() {
+		check(!driver.stream_begin(wave, 0, 10), "empty buffer rejected");
+		check(!driver.streaming() && !direct(), "no stream from an empty buffer");
+
+		expected = 0;
+		check(driver.stream_begin(wave, BUFFER, 10), "begin");
+		check(direct(), "begin enters direct_mode");
+		expected = 0;
+		driver.stream_begin(wave, BUFFER, 10);	// Restart
+		driver.stream_end();
+		check(!direct(), "end after a restart leaves direct_mode");
+
+		expected = 0;
+		driver.stream_begin(wave, BUFFER, 10, false);
+		while (driver.streaming()) {
+			host_advance(10);
+			driver.stream_tick();
+		}
+		check(!direct(), "a single pass leaves direct_mode");
+		driver.direct_mode(true);
+		driver.stream_end();
+		check(direct(), "end after the stream ended leaves direct_mode alone");
+
+		expected = 0;
+		driver.stream_begin(wave, BUFFER, 10);
+		driver.stream_end();
+		check(direct(), "end keeps the direct_mode set before the stream");
+		driver.direct_mode(false);
+	}
+}
+
+int main(int argc, char **argv) {
+	if (argc > 1) overhead_us = atoi(argv[1]);
+	uint32_t tick_us = argc > 2 ? max(1, atoi(argv[2])) : 1;
+
+	for (uint16_t i = 0; i < BUFFER; i++) {
+		float phase = 2 * M_PI * i / BUFFER;
+		wave[i] = TMC2130Stepper::coil_pack(lround(248 * sin(phase)), lround(248 * cos(phase)));
+	}
+	sim.attach(driver);
+	driver.bus_backend(backend, &sim);
+	driver.begin();
+	check_begin_end();
+
+	printf("overhead %uus per datagram, timer tick %uus\n", overhead_us, tick_us);
+	printf("spi_mhz,frame_us,write_us,period_us,rate_hz,max_lag_us\n");
+	const float spi_mhz[] = { 0.5, 1, 2, 4, 8 };
+	for (uint8_t s = 0; s < sizeof(spi_mhz)/sizeof(spi_mhz[0]); s++) {
+		sim.frame_us = ceil(40 / spi_mhz[s]);
+		TMC2130_stream_stats_t best = {};
+		uint32_t best_period = 0;
+		for (uint32_t period = 200; period >= tick_us; period--) {
+			TMC2130_stream_stats_t st = run(period, tick_us);
+			if (st.late) break;
+			best = st;
+			best_period = period;
+		}
+		printf("%.1f,%u,%u,%u,%u,%u\n", spi_mhz[s], sim.frame_us, best.frame_time, best_period,
+			best_period ? 1000000 / best_period : 0, best.max_lag);
+	}
+
+	printf("%s: %u mismatches\n", mismatches ? "FAIL" : "PASS", mismatches);
+	return mismatches ? 1 : 0;
+}
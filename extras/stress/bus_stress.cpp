@@ -0,0 +1,143 @@
+/*
+	Stress test of the bus arbiter (TMC2130Bus) on the host.
+
+	Two simulated drivers share the bus. The main loop writes random
+	CHOPCONF values to driver A and reads them back, and reads the IOIN
+	version of driver B. Before a datagram reaches the simulator an
+	"interrupt" may fire, so interrupts land between the two datagrams of
+	a read and inside each other, up to two levels deep. They also fire
+	between the accesses of the main loop. The interrupt handler uses both
+	ways to reach the bus from an interrupt:
+	- driver functions: a TPWMTHRS write to driver B and a version read
+	  of driver A, which must either be correct or counted as dropped
+	  and flagged by read_dropped()
+	- submit(): a queued IOIN read of driver A, checked in its callback
+
+	Any mixed up reply shows up as a mismatch. At the end, the last
+	TPWMTHRS written must have reached driver B, even when it was queued.
+	Exits with 1 on a mismatch.
+
+	Build and run from the repository root:
+
+	g++ -std=gnu++11 -O2 -Isrc -Iextras/simulator extras/stress/bus_stress.cpp \
+		extras/simulator/TMC2130Sim.cpp src/source/[A-Z]*.cpp -o bus_stress
+	./bus_stress [iterations]
+*/
+#include <TMC2130Stepper.h>
+#include <TMC2130Stepper_REGDEFS.h>
+#include <TMC2130Stepper_REGMAP.h>
+#include <TMC2130Sim.h>
+
+#define VERSION 	0x11
+#define MAX_DEPTH 	2
+
+namespace {
+	TMC2130Stepper driver_a(2, 3, 4, 10);
+	TMC2130Stepper driver_b(5, 6, 7, 11);
+	TMC2130Sim sim_a(2, 3, 4);
+	TMC2130Sim sim_b(5, 6, 7);
+
+	uint32_t rng = 1;
+	uint32_t random32() {
+		rng = rng * 1664525UL + 1013904223UL;
+		return rng;
+	}
+
+	struct {
+		uint32_t interrupts;
+		uint32_t nested;
+		uint32_t while_busy;
+		uint32_t reads_ok;
+		uint32_t reads_dropped;
+		uint32_t submitted;
+		uint32_t completed;
+		uint32_t mismatches;
+	} count;
+
+	uint8_t depth = 0;
+	uint32_t tpwmthrs = 0;
+	bool armed = false;
+
+	void mismatch(const char *what, uint32_t got, uint32_t expected) {
+		if (count.mismatches++ < 10) printf("mismatch %s: 0x%08X, expected 0x%08X\n", what, got, expected);
+	}
+
+	void ioin_done(void *, uint32_t value, uint8_t) {
+		count.completed++;
+		uint8_t version = value >> VERSION_bp;
+		if (version != VERSION) mismatch("queued IOIN", value, VERSION << VERSION_bp);
+	}
+
+	void isr() {
+		count.interrupts++;
+		if (depth) count.nested++;
+		if (TMC2130Bus::spi.busy()) count.while_busy++;
+		depth++;
+
+		tpwmthrs = random32() & TPWMTHRS_bm;
+		driver_b.TPWMTHRS(tpwmthrs);
+
+		uint32_t dropped = TMC2130Bus::spi.stats().dropped;
+		uint8_t version = driver_a.version();
+		// The count also moves for reads dropped by nested interrupts
+		bool counted = TMC2130Bus::spi.stats().dropped != dropped;
+		if (driver_a.read_dropped() && !counted) mismatch("read_dropped", 1, 0);
+		if (driver_a.read_dropped()) count.reads_dropped++;
+		else if (version == VERSION) count.reads_ok++;
+		else mismatch("IOIN in interrupt", version, VERSION);
+
+		if (TMC2130Bus::spi.submit(driver_a, REG_IOIN, 0, ioin_done, NULL, random32() & 3)) count.submitted++;
+		depth--;
+	}
+
+	void maybe_interrupt() {
+		if (armed && depth < MAX_DEPTH && random32() % 3 == 0) isr();
+	}
+
+	// Sits in front of the simulator and fires interrupts between datagrams
+	void backend(void *ctx, uint8_t *datagram) {
+		maybe_interrupt();
+		static_cast<TMC2130Sim*>(ctx)->datagram(datagram);
+	}
+}
+
+int main(int argc, char **argv) {
+	uint32_t iterations = argc > 1 ? max(1, atoi(argv[1])) : 10000;
+
+	sim_a.attach(driver_a);
+	sim_b.attach(driver_b);
+	driver_a.bus_backend(backend, &sim_a);
+	driver_b.bus_backend(backend, &sim_b);
+	driver_a.begin();
+	driver_b.begin();
+	armed = true;
+
+	for (uint32_t i = 0; i < iterations; i++) {
+		uint32_t chopconf = random32() & TMC2130_n::CHOPCONF_r::mask;
+		maybe_interrupt();
+		driver_a.CHOPCONF(chopconf);
+		maybe_interrupt();
+		uint32_t read = driver_a.CHOPCONF();
+		if (read != chopconf) mismatch("CHOPCONF", read, chopconf);
+
+		maybe_interrupt();
+		uint8_t version = driver_b.version();
+		if (version != VERSION) mismatch("IOIN", version, VERSION);
+	}
+	armed = false;
+	driver_a.GCONF(); // Any access drains the queue
+
+	uint32_t reached = sim_b.peek(REG_TPWMTHRS);
+	if (reached != tpwmthrs) mismatch("TPWMTHRS", reached, tpwmthrs);
+	if (count.completed != count.submitted) mismatch("callbacks", count.completed, count.submitted);
+
+	const TMC2130_bus_stats_t &s = TMC2130Bus::spi.stats();
+	printf("interrupts %u, nested %u, while busy %u\n", count.interrupts, count.nested, count.while_busy);
+	printf("interrupt reads %u ok, %u dropped; submitted %u, completed %u\n",
+		count.reads_ok, count.reads_dropped, count.submitted, count.completed);
+	printf("bus: transactions %u, contended %u, deferred %u, dropped %u, wait max %uus, mean %.1fus\n",
+		s.transactions, s.contended, s.deferred, s.dropped, s.wait_max,
+		s.deferred ? (double)s.wait_total / s.deferred : 0.0);
+	printf("%s: %u mismatches\n", count.mismatches ? "FAIL" : "PASS", count.mismatches);
+	return count.mismatches ? 1 : 0;
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""
+Decodes the chunks written by TMC2130Telemetry::drain() into CSV.
+
+Usage: telemetry_decode.py [capture.bin]
+Reads from stdin when no file is given. Bytes between chunks, like text
+printed by the sketch, are skipped.
+"""
+import sys
+
+MAGIC = 0xA7
+FIELDS = ['sg_result', 'cs_actual', 'tstep', 'pwm_scale', 'flags']
+
+
+def varint(data, pos):
+	value = shift = 0
+	while True:
+		b = data[pos]
+		pos += 1
+		value |= (b & 0x7F) << shift
+		shift += 7
+		if not b & 0x80:
+			return value, pos
+
+
+def unzigzag(v):
+	return (v >> 1) ^ -(v & 1)
+
+
+def decode(data):
+	pos = 0
+	while pos < len(data):
+		if data[pos] != MAGIC:
+			pos += 1
+			continue
+		try:
+			fields = [f for i, f in enumerate(FIELDS) if data[pos+1] & (1 << i)]
+			p = pos + 2
+			interval, p = varint(data, p)
+			time, p = varint(data, p)
+			dropped, p = varint(data, p)
+			count, p = varint(data, p)
+			values = []
+			for _ in fields:
+				v, p = varint(data, p)
+				values.append(v)
+			records = []
+			for _ in range(count):
+				dt, p = varint(data, p)
+				time += dt
+				for i in range(len(fields)):
+					d, p = varint(data, p)
+					values[i] = (values[i] + unzigzag(d)) & 0xFFFFFFFF
+				records.append([time] + values)
+		except IndexError:
+			break # Incomplete chunk at the end of the capture
+		yield fields, dropped, records
+		pos = p
+
+
+def main():
+	src = open(sys.argv[1], 'rb') if len(sys.argv) > 1 else sys.stdin.buffer
+	header = None
+	for fields, dropped, records in decode(src.read()):
+		if fields != header:
+			header = fields
+			print(','.join(['time_ms'] + fields))
+		if dropped:
+			print('# %d records dropped' % dropped)
+		for r in records:
+			print(','.join(str(v) for v in r))
+
+
+if __name__ == '__main__':
+	main()
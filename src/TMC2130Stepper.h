@@ -2,13 +2,90 @@
 #define TMC2310Stepper_h
 
 //#define TMC2130DEBUG
+//#define TMC2130_SPI_STATS // Count bus traffic in send2130. Costs ~500 bytes of RAM per driver.
+							// Changes the class layout: set it here or as a global build flag,
+							// never with a #define in the sketch only.
 
 #if defined(ARDUINO) && ARDUINO >= 100
 	#include <Arduino.h>
+#elif !defined(ARDUINO)
+	#include "TMC2130Stepper_HOST.h"
 #endif
+#include "TMC2130Stepper_BUS.h"
+#include "TMC2130Stepper_REGMAP.h"
+
+// Field accessors declared from the field table in TMC2130Stepper_REGMAP.h
+#define TMC2130_ACCESSORS_RW(FIELD, NAME) \
+	void NAME(TMC2130_n::FIELD##_f::type B); \
+	TMC2130_n::FIELD##_f::type NAME();
+#define TMC2130_ACCESSORS_R(FIELD, NAME) 	TMC2130_n::FIELD##_f::type NAME();
+#define TMC2130_ACCESSORS_X(FIELD, NAME)
+#define TMC2130_ACCESSORS_ALIAS(FIELD, NAME)
+#define TMC2130_ACCESSORS(KIND, REG, FIELD, NAME, ...) 	TMC2130_ACCESSORS_##KIND(FIELD, NAME)
 
 const uint32_t TMC2130Stepper_version = 0x10100; // v1.1.0
 
+// Result of TMC2130Stepper::selfTest()
+struct TMC2130_selftest_t {
+	uint8_t 	version;	// IOIN version byte as read from the chip
+	bool 		spi;		// Version byte matched, SPI link is alive
+	bool 		readback;	// Scratch write to XDIRECT read back correctly
+	bool 		reset;		// Reset flag was set (GSTAT). Reading GSTAT cleared it
+	bool 		uv_cp;		// Charge pump undervoltage (GSTAT)
+	bool 		drv_err;	// Driver shut down due to ot or s2g (GSTAT)
+	bool 		energised;	// The DRV_STATUS checks below ran. Not with toff == 0
+	bool 		ot;			// Overtemperature shutdown while energised
+	bool 		s2ga;		// Short to ground on phase A while energised
+	bool 		s2gb;		// Short to ground on phase B while energised
+	bool 		ola;		// Open load on phase A while energised
+	bool 		olb;		// Open load on phase B while energised
+	bool 		timeout;	// Time budget ran out before all checks completed
+	uint16_t 	duration;	// Time spent in ms
+};
+
+// Motor data for TMC2130Stepper::tuneChopper()
+struct TMC2130_motor_t {
+	float L;	// Coil inductance in mH
+	float R;	// Coil resistance in Ohm
+	float VM;	// Supply voltage in V
+};
+
+// Result of TMC2130Stepper::tuneChopper()
+struct TMC2130_chopper_t {
+	uint8_t 	toff;				// off_time() setting
+	uint8_t 	blank_time;			// Clock cycles, 16, 24, 36 or 54
+	uint8_t 	hysterisis_start;	// 1..8
+	int8_t 		hysterisis_low;		// -3..12
+	uint32_t 	f_chop;				// Theoretical maximum chopper frequency in Hz
+	uint16_t 	noise;				// StallGuard variance of the chosen setting, 0 if not refined
+	bool 		refined;			// Settings were refined with the motor running
+};
+
+// Timing of TMC2130Stepper::stream_tick()
+struct TMC2130_stream_stats_t {
+	uint32_t samples;		// Coil values written
+	uint32_t late;			// Samples written more than one period after they were due
+	uint32_t max_lag;		// Longest delay behind schedule in us
+	uint16_t frame_time;	// Longest time for one XDIRECT write in us
+};
+
+#ifdef TMC2130_SPI_STATS
+	#define TMC2130_STATS_REGS 0x74 // REG_LOST_STEPS+1
+	#define TMC2130_STATS_BINS 8
+	// Bus traffic counters, see TMC2130Stepper::spi_stats()
+	struct TMC2130_spi_stats_t {
+		uint32_t frames;						// 40 bit datagrams
+		uint32_t bytes;
+		uint16_t reads[TMC2130_STATS_REGS];		// Per register address
+		uint16_t writes[TMC2130_STATS_REGS];
+		uint32_t latency[TMC2130_STATS_BINS];	// Calls taking <16, <32, <64 ... >=1024us
+		uint32_t latency_max;					// us
+	};
+#endif
+
+// Replaces hardware SPI, see TMC2130Stepper::bus_backend()
+typedef void (*TMC2130_bus_t)(void *ctx, uint8_t *datagram);
+
 class TMC2130Stepper {
 	public:
 		TMC2130Stepper(uint8_t pinEN, uint8_t pinDIR, uint8_t pinStep, uint8_t pinCS);
@@ -23,69 +100,46 @@ class TMC2130Stepper {
 		bool getOTPW();
 		void clear_otpw();
 		bool isEnabled();
+		bool selfTest(TMC2130_selftest_t &result, uint16_t budget_ms=50);
+		bool tuneChopper(const TMC2130_motor_t &motor, TMC2130_chopper_t &result,
+			void (*run)(uint16_t steps_per_s)=NULL, const uint16_t *speeds=NULL, uint8_t count=0);
+		void restore();
+		uint32_t shadow(uint8_t address);
+		void bus_backend(TMC2130_bus_t backend, void *ctx=NULL);
+		void resync();
+		void bus_arbiter(TMC2130Bus &arbiter);
+		TMC2130Bus& bus_arbiter();
+		bool read_dropped();
+		void auto_restore(bool enable);
+		bool auto_restore();
+		uint16_t resets();
+		uint16_t restore_failures();
+		uint8_t scrub(uint16_t budget_us=0);
+		void scrub_refresh(bool enable);
+		uint16_t scrub_mismatches(uint8_t address);
+		uint32_t scrub_checks();
+		void scrub_clear();
+#ifdef TMC2130_SPI_STATS
+		const TMC2130_spi_stats_t& spi_stats();
+		void clear_spi_stats();
+#endif
 //    void takeSteps(int steps);
 //    void step(int steps, int speed);
 		// GCONF
 		uint32_t GCONF();
 		void GCONF(								uint32_t value);
-		void I_scale_analog(			bool B);
-		void internal_Rsense(			bool B);
-		void en_pwm_mode(					bool B);
-		void enc_commutation(			bool B);
-		void shaft(								bool B);
-		void diag0_error(					bool B);
-		void diag0_otpw(					bool B);
-		void diag0_stall(					bool B);
-		void diag1_stall(					bool B);
-		void diag1_index(					bool B);
-		void diag1_onstate(				bool B);
-		void diag1_steps_skipped(	bool B);
-		void diag0_int_pushpull(	bool B);
-		void diag1_pushpull(			bool B);
-		void small_hysterisis(		bool B);
-		void stop_enable(					bool B);
-		void direct_mode(					bool B);
-		bool I_scale_analog();
-		bool internal_Rsense();
-		bool en_pwm_mode();
-		bool enc_commutation();
-		bool shaft();
-		bool diag0_error();
-		bool diag0_otpw();
-		bool diag0_stall();
-		bool diag1_stall();
-		bool diag1_index();
-		bool diag1_onstate();
-		bool diag1_steps_skipped();
-		bool diag0_int_pushpull();
-		bool diag1_pushpull();
-		bool small_hysterisis();
-		bool stop_enable();
-		bool direct_mode();
+		TMC2130_GCONF_FIELDS(TMC2130_ACCESSORS)
 		// IHOLD_IRUN
 		void IHOLD_IRUN(					uint32_t input);
 		uint32_t IHOLD_IRUN();
-		void 	ihold(							uint8_t B);
-		void 	irun(								uint8_t B);
-		void 	iholddelay(					uint8_t B);
-		uint8_t ihold();
-		uint8_t irun();
-		uint8_t iholddelay();
+		TMC2130_IHOLD_IRUN_FIELDS(TMC2130_ACCESSORS)
 		// GSTAT
 		void 	GSTAT(							uint8_t input);
 		uint8_t GSTAT();
-		bool 	reset();
-		bool 	drv_err();
-		bool 	uv_cp();
+		TMC2130_GSTAT_FIELDS(TMC2130_ACCESSORS)
 		// IOIN
 		uint32_t 	IOIN();
-		bool 		step();
-		bool 		dir();
-		bool 		dcen_cfg4();
-		bool 		dcin_cfg5();
-		bool 		drv_enn_cfg6();
-		bool 		dco();
-		uint8_t 	version();
+		TMC2130_IOIN_FIELDS(TMC2130_ACCESSORS)
 		// TPOWERDOWN
 		uint32_t TPOWERDOWN();
 		void TPOWERDOWN(					uint32_t input);
@@ -103,102 +157,46 @@ class TMC2130Stepper {
 		// XDRIRECT
 		uint32_t XDIRECT();
 		void XDIRECT(							uint32_t input);
-		void coil_A(							int16_t 	B);
-		void coil_B(							int16_t 	B);
-		int16_t coil_A();
-		int16_t coil_B();
+		TMC2130_XDIRECT_FIELDS(TMC2130_ACCESSORS)
+		void coil_AB(							int16_t A, int16_t B);
+		static uint32_t coil_pack(int16_t A, int16_t B);
+		bool stream_begin(const uint32_t *buffer, uint16_t count, uint32_t period_us, bool repeat=true);
+		bool stream_tick();
+		void stream_end();
+		bool streaming();
+		const TMC2130_stream_stats_t& stream_stats();
 		// VDCMIN
 		uint32_t VDCMIN();
 		void VDCMIN(							uint32_t input);
+		// MSCNT
+		uint16_t MSCNT();
 		// CHOPCONF
 		uint32_t CHOPCONF();
 		void CHOPCONF(						uint32_t value);
-		void toff(								uint8_t B);
-		void hstrt(								uint8_t B);
-		void hend(								int8_t  B);
+		TMC2130_CHOPCONF_FIELDS(TMC2130_ACCESSORS)
 		void fd(									uint8_t B);
-		void disfdcc(							bool 		B);
-		void rndtf(								bool 		B);
-		void chm(									bool 		B);
-		void tbl(									uint8_t B);
-		void vsense(							bool 		B);
-		void vhighfs(							bool 		B);
-		void vhighchm(						bool 		B);
-		void sync(								uint8_t B);
-		void mres(								uint8_t B);
-		void intpol(							bool 		B);
-		void dedge(								bool 		B);
-		void diss2g(							bool 		B);
-		uint8_t toff();
-		uint8_t hstrt();
-		int8_t  hend();
 		uint8_t fd();
-		bool 	disfdcc();
-		bool 	rndtf();
-		bool 	chm();
-		uint8_t tbl();
-		bool 	vsense();
-		bool 	vhighfs();
-		bool 	vhighchm();
-		uint8_t sync();
-		uint8_t mres();
-		bool 	intpol();
-		bool 	dedge();
-		bool 	diss2g();
 		// COOLCONF
 		void COOLCONF(uint32_t value);
 		uint32_t COOLCONF();
-		void semin(								uint8_t B);
-		void seup(								uint8_t B);
-		void semax(								uint8_t B);
-		void sedn(								uint8_t B);
-		void seimin(							bool 		B);
-		void sgt(									uint8_t B);
-		void sfilt(								bool 		B);
-		uint8_t semin();
-		uint8_t seup();
-		uint8_t semax();
-		uint8_t sedn();
-		bool seimin();
-		uint8_t sgt();
-		bool sfilt();
+		TMC2130_COOLCONF_FIELDS(TMC2130_ACCESSORS)
+		// DCCTRL
+		void DCCTRL(							uint32_t input);
+		uint32_t DCCTRL();
+		TMC2130_DCCTRL_FIELDS(TMC2130_ACCESSORS)
 		// PWMCONF
 		void PWMCONF(							uint32_t value);
 		uint32_t PWMCONF();
-		void pwm_ampl(						uint8_t B);
-		void pwm_grad(						uint8_t B);
-		void pwm_freq(						uint8_t B);
-		void pwm_autoscale(				bool		B);
-		void pwm_symmetric(				bool		B);
-		void freewheel(						uint8_t B);
-		uint8_t pwm_ampl();
-		uint8_t pwm_grad();
-		uint8_t pwm_freq();
-		bool 	pwm_autoscale();
-		bool 	pwm_symmetric();
-		uint8_t freewheel();
+		TMC2130_PWMCONF_FIELDS(TMC2130_ACCESSORS)
 		// DRVSTATUS
 		uint32_t DRV_STATUS();
-		uint16_t sg_result();
-		bool fsactive();
-		uint8_t cs_actual();
-		bool stallguard();
-		bool ot();
-		bool otpw();
-		bool s2ga();
-		bool s2gb();
-		bool ola();
-		bool olb();
-		bool stst();
+		TMC2130_DRV_STATUS_FIELDS(TMC2130_ACCESSORS)
 		// PWM_SCALE
 		uint8_t PWM_SCALE();
 		// ENCM_CTRL
 		uint8_t ENCM_CTRL();
 		void ENCM_CTRL(						uint8_t input);
-		void inv(									bool B);
-		void maxspeed(						bool B);
-		bool inv();
-		bool maxspeed();
+		TMC2130_ENCM_CTRL_FIELDS(TMC2130_ACCESSORS)
 		// LOST_STEPS
 		uint32_t LOST_STEPS();
 
@@ -213,6 +211,20 @@ class TMC2130Stepper {
 		uint8_t hysterisis_start();
 		void sg_current_decrease(uint8_t value);
 		uint8_t sg_current_decrease();
+		uint32_t tstep_to_speed(uint32_t tstep);
+		uint32_t speed_to_tstep(uint32_t steps_per_s);
+		uint32_t velocity();
+		uint32_t velocity_raw();
+		void velocity_filter(uint8_t shift);
+		void dcstep_speed(uint32_t steps_per_s);
+		uint32_t dcstep_speed();
+		void dcstep_auto();
+		void dcstep_pins(uint8_t pinDCEN, uint8_t pinDCO);
+		void dcstep_enable(bool enable);
+		bool dcstep_wait();
+		bool dcstep_ready(uint16_t timeout_us);
+		uint32_t dcstep_waits();
+		uint16_t dcstep_stalls();
 
 		// Aliases
 
@@ -264,8 +276,8 @@ class TMC2130Stepper {
 		inline void 		mode_sw_speed(		uint32_t value)	__attribute__((always_inline)) {				THIGH(value); 							}
 		// RW: XDIRECT
 		inline int16_t 	coil_A_current()									__attribute__((always_inline)) { return coil_A(); 									}
-		inline void 		coil_A_current(		 int16_t value)	__attribute__((always_inline)) {				coil_B(value); 							}
-		inline int16_t 	coil_B_current()									__attribute__((always_inline)) { return coil_A(); 									}
+		inline void 		coil_A_current(		 int16_t value)	__attribute__((always_inline)) {				coil_A(value); 							}
+		inline int16_t 	coil_B_current()									__attribute__((always_inline)) { return coil_B(); 									}
 		inline void 		coil_B_current(		 int16_t value)	__attribute__((always_inline)) {				coil_B(value); 							}
 		// W
 		inline uint32_t DCstep_min_speed()								__attribute__((always_inline)) { return VDCMIN(); 									}
@@ -339,6 +351,7 @@ class TMC2130Stepper {
 
 
 		float Rsense = 0.11;
+		uint32_t fclk = 12000000; // Internal clock is 12MHz nominal, set when using an external clock
 		bool _started;
 		uint8_t status_response;
 
@@ -375,16 +388,53 @@ class TMC2130Stepper {
 							COOLCONF_sr 	= 0x00000000UL,
 							DCCTRL_sr 		= 0x00000000UL,
 							PWMCONF_sr 		= 0x00000000UL,
-							tmp_sr 				= 0x00000000UL,
 							TPOWERDOWN_sr = 0x00000000UL,
 							ENCM_CTRL_sr 	= 0x00000000UL,
 							GSTAT_sr			= 0x00000000UL,
 						  MSLUTSTART_sr = 0x00000000UL;
 
+		friend class TMC2130Bus;
 		void send2130(uint8_t addressByte, uint32_t *config);
+		void transact(uint8_t addressByte, uint32_t *config);
+		uint32_t transfer2130(uint8_t addressByte, uint32_t data);
+		uint32_t read_pipelined(uint8_t address);
+		void recover(uint8_t addressByte, uint32_t *config);
 
 		uint16_t val_mA           = 0;
 		bool flag_otpw            = 0;
+		bool _auto_restore        = true;
+		bool _restoring           = false;
+		volatile bool _replay     = false; // A write was lost to a full bus queue
+		volatile bool _read_dropped = false; // The last read found the bus taken
+		uint16_t reset_count      = 0;
+		uint16_t restore_fails    = 0;    // Reset flag still set after a restore
+		uint8_t last_frame        = 0xFF; // Address byte of the last datagram
+		TMC2130_bus_t bus         = NULL;
+		void *bus_ctx             = NULL;
+		TMC2130Bus *arbiter       = &TMC2130Bus::spi;
+		uint32_t velocity_sr      = 0;    // Filtered velocity, 8 fractional bits
+		uint32_t velocity_last    = 0;
+		uint8_t velocity_shift    = 3;
+		uint8_t _pinDCEN          = 0xFF; // Not connected
+		uint8_t _pinDCO           = 0xFF;
+		uint8_t scrub_pos         = 0;    // Next entry of the scrub rotation
+		bool scrub_wo             = false;
+		uint16_t scrub_frame_us   = 0;    // Time per datagram seen while scrubbing
+		uint32_t scrub_count      = 0;
+		uint16_t scrub_errors[3]  = {};   // GCONF, CHOPCONF, XDIRECT
+		uint32_t dco_waits        = 0;
+		uint16_t dco_stalls       = 0;
+		const uint32_t *stream_buf = NULL;
+		uint16_t stream_count     = 0;
+		uint16_t stream_pos       = 0;
+		uint32_t stream_period    = 0;
+		uint32_t stream_due       = 0;
+		bool stream_repeat        = false;
+		bool stream_direct        = false;
+		TMC2130_stream_stats_t stream_st = {};
+#ifdef TMC2130_SPI_STATS
+		TMC2130_spi_stats_t stats = {};
+#endif
 };
 
 #endif
\ No newline at end of file
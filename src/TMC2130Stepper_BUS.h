@@ -0,0 +1,96 @@
+#ifndef TMC2130Stepper_BUS_h
+#define TMC2130Stepper_BUS_h
+
+// Included from TMC2130Stepper.h
+
+#ifndef TMC2130_BUS_QUEUE
+	#define TMC2130_BUS_QUEUE 8		// Transactions waiting for a busy bus, all drivers
+#endif
+
+class TMC2130Stepper;
+
+// Completion of a queued transaction. value is the register read or written.
+typedef void (*TMC2130_bus_done_t)(void *ctx, uint32_t value, uint8_t status);
+
+// Counters of TMC2130Bus::stats()
+struct TMC2130_bus_stats_t {
+	uint32_t transactions;	// Register accesses completed, direct and queued
+	uint32_t contended;		// Accesses that found the bus in use
+	uint32_t deferred;		// Of these, queued and completed later
+	uint32_t dropped;		// Of these, lost: reads without submit() or a full queue
+	uint32_t wait_total;	// us from queueing to completion, all deferred transactions
+	uint32_t wait_max;		// us
+};
+
+/*
+	Arbitrates one SPI bus between the main loop and interrupts.
+
+	Every register access of a driver takes the bus for the one or two
+	datagrams it needs. Interrupts stay enabled. When an interrupt finds
+	the bus taken, the access cannot wait, since the code holding the bus
+	only continues after the interrupt returns. Instead:
+	- submit() queues the transaction and calls `done` once it completed
+	- register writes through the driver functions are queued the same
+	  way, the shadow register already holds the new value
+	- register reads through the driver functions return the shadow value,
+	  or 0 for registers without one, are counted as dropped and set the
+	  driver's read_dropped()
+
+	Whoever releases the bus runs the queued transactions first, highest
+	priority first and in order of arrival within a priority. The `done`
+	callbacks run after the bus was released again, so they may use the
+	driver functions.
+
+	The queue is a fixed array of entries claimed with an atomic compare
+	and swap, so interrupts of different priorities can queue at the same
+	time. On AVR the atomic operations mask interrupts for a few cycles.
+
+	All drivers use TMC2130Bus::spi unless given another arbiter with
+	TMC2130Stepper::bus_arbiter(), e.g. for drivers on a separate bus.
+	TMC2130SoftSPI::attach() does that with the arbiter of its bus.
+*/
+class TMC2130Bus {
+	public:
+		bool acquire();
+		void release();
+		bool submit(TMC2130Stepper &driver, uint8_t address, uint32_t data=0,
+			TMC2130_bus_done_t done=NULL, void *ctx=NULL, uint8_t priority=0);
+		uint8_t pending();
+		bool busy();
+		const TMC2130_bus_stats_t& stats();
+		void clear_stats();
+
+		static TMC2130Bus spi;
+
+	private:
+		friend class TMC2130Stepper;
+		enum { FREE, CLAIMED, PENDING, RUNNING, DONE, COMPLETING };
+		struct entry_t {
+			TMC2130Stepper 			*driver;
+			TMC2130_bus_done_t 		done;
+			void 					*ctx;
+			uint32_t 				data;
+			uint32_t 				queued;		// us
+			uint8_t 				address;
+			uint8_t 				priority;
+			uint8_t 				seq;
+			uint8_t 				status;
+			volatile uint8_t 		state;
+		};
+		bool queue(TMC2130Stepper &driver, uint8_t address, uint32_t data,
+			TMC2130_bus_done_t done, void *ctx, uint8_t priority);
+		entry_t* next();
+		void run_queue();
+		void complete();
+		void dropped();
+
+		// No initialisers: static instances are zero filled before any constructor runs
+		entry_t entries[TMC2130_BUS_QUEUE];
+		volatile uint8_t _busy;
+		volatile uint8_t _pending;
+		volatile uint8_t _completed;
+		volatile uint8_t seq;
+		TMC2130_bus_stats_t _stats;
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef TMC2130Stepper_DIAG_h
+#define TMC2130Stepper_DIAG_h
+
+#include "TMC2130Stepper.h"
+
+#define TMC2130_DIAG_SLOTS 		4	// DIAG pins with an interrupt, over all instances
+#ifndef TMC2130_DIAG_HANDLERS
+	#define TMC2130_DIAG_HANDLERS 4
+#endif
+
+// Event bits
+#define DIAG_EVENT_STALL	0x01
+#define DIAG_EVENT_ERROR	0x02	// ot, s2ga or s2gb
+#define DIAG_EVENT_OTPW		0x04
+#define DIAG_EVENT_INDEX	0x08
+
+typedef void (*TMC2130_diag_handler_t)(uint8_t events, uint32_t drv_status);
+
+/*
+	Watches the DIAG0/DIAG1 outputs instead of polling DRV_STATUS.
+
+	begin() routes the requested events to the pins in GCONF and attaches
+	an interrupt to the active edge of each pin. DIAG0 can signal
+	DIAG_EVENT_ERROR, _OTPW and _STALL, DIAG1 _STALL and _INDEX. The
+	interrupt only marks the pin as pending. dispatch(), called from
+	loop(), then reads DRV_STATUS once to tell the events apart and calls
+	the handlers registered for them. Index pulses are counted and do not
+	cause a bus access. Pins without an external interrupt are polled
+	with digitalRead() in dispatch(), which still costs no SPI traffic.
+
+	Open drain outputs (the default) are active low and use the internal
+	pull-up. With `pushpull` they are active high.
+
+	The interrupts are edge triggered: an event that persists, like OTPW,
+	is reported once until the pin goes inactive again.
+*/
+class TMC2130Diag {
+	public:
+		TMC2130Diag(TMC2130Stepper &driver, uint8_t pinDIAG0, uint8_t pinDIAG1=0xFF);
+		bool begin(uint8_t diag0_events, uint8_t diag1_events=0, bool pushpull=false);
+		void end();
+		bool on(uint8_t events, TMC2130_diag_handler_t handler);
+		uint8_t dispatch();
+		bool pending();
+		uint16_t count(uint8_t event);
+		uint32_t index_pulses();
+		uint32_t status_reads();
+
+	private:
+		struct slot_t {
+			TMC2130Diag *diag;
+			uint8_t 	line;
+		};
+		struct handler_t {
+			uint8_t 				events;
+			TMC2130_diag_handler_t 	fn;
+		};
+		static slot_t slots[TMC2130_DIAG_SLOTS];
+		template<uint8_t N> static void isr();
+		static void (* const isrs[TMC2130_DIAG_SLOTS])();
+		void fire(uint8_t line);
+		bool attach(uint8_t line);
+		bool active(uint8_t line);
+
+		TMC2130Stepper &drv;
+		uint8_t pin[2];
+		uint8_t routed[2] = {0, 0};			// DIAG_EVENT_* per pin
+		int8_t 	slot[2] = {-1, -1};			// -1 when polled
+		uint8_t last_level[2];
+		bool 	_pushpull = false;
+		handler_t handlers[TMC2130_DIAG_HANDLERS];
+		uint8_t handler_count = 0;
+		volatile uint8_t lines = 0;			// Pending pins, bit 0 = DIAG0
+		volatile uint16_t index_pending = 0;		// Index pulses not dispatched yet
+		uint16_t counts[4] = {0, 0, 0, 0};
+		uint32_t _index_pulses = 0;
+		uint32_t _status_reads = 0;
+};
+
+#endif
@@ -0,0 +1,203 @@
+#ifndef TMC2130Stepper_FASTIO_h
+#define TMC2130Stepper_FASTIO_h
+
+#include "TMC2130Stepper.h"
+#ifdef ARDUINO
+	#include <SPI.h>
+#endif
+
+/*
+	Compile time pins.
+
+	TMC2130_fastio::pin_t<PIN> resolves an Arduino pin number to its port
+	register and bit at compile time. On the ATmega168/328P and the
+	ATmega1280/2560 high(), low() and toggle() then compile to single
+	sbi/cbi/out instructions, instead of the table lookups digitalWrite()
+	does at runtime. Ports above the I/O space (PORTH..PORTL on the Mega)
+	need a read-modify-write, which is done with interrupts disabled. On
+	other boards, and for pins the map does not know, pin_t falls back to
+	digitalWrite().
+
+	gpio_t is the runtime counterpart for pins that are only known at
+	runtime, used by TMC2130SoftSPI.
+
+	TMC2130StepperT<EN, DIR, STEP, CS> is TMC2130Stepper with the chip
+	select handled by pin_t, through a bus backend. The register
+	functions are the same. It also has fast step, direction and enable
+	outputs for step generation in interrupts:
+
+	TMC2130StepperT<38, 55, 54, 40> driver;
+	ISR(TIMER1_COMPA_vect) { driver.step_pulse(); }
+*/
+namespace TMC2130_fastio {
+
+	// Port index (A=0 .. L=10, no I) and bit, packed as index<<3 | bit
+	#define TMC2130_PIN(PORT, BIT)	(((PORT) - 'A' - ((PORT) > 'I')) << 3 | (BIT))
+	#define TMC2130_NC				0xFF
+
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega168P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega328P__)
+	constexpr uint8_t pin_map(uint8_t pin) {
+		return 	pin < 8  ? TMC2130_PIN('D', pin) :
+				pin < 14 ? TMC2130_PIN('B', pin - 8) :
+				pin < 20 ? TMC2130_PIN('C', pin - 14) : TMC2130_NC;
+	}
+#elif defined(__AVR_ATmega1280__) || defined(__AVR_ATmega2560__)
+	// Same order as digital_pin_to_port_PGM in the Mega pins_arduino.h
+	constexpr uint8_t mega_pins[70] = {
+		TMC2130_PIN('E',0), TMC2130_PIN('E',1), TMC2130_PIN('E',4), TMC2130_PIN('E',5), // 0
+		TMC2130_PIN('G',5), TMC2130_PIN('E',3), TMC2130_PIN('H',3), TMC2130_PIN('H',4),
+		TMC2130_PIN('H',5), TMC2130_PIN('H',6), TMC2130_PIN('B',4), TMC2130_PIN('B',5), // 8
+		TMC2130_PIN('B',6), TMC2130_PIN('B',7), TMC2130_PIN('J',1), TMC2130_PIN('J',0),
+		TMC2130_PIN('H',1), TMC2130_PIN('H',0), TMC2130_PIN('D',3), TMC2130_PIN('D',2), // 16
+		TMC2130_PIN('D',1), TMC2130_PIN('D',0), TMC2130_PIN('A',0), TMC2130_PIN('A',1),
+		TMC2130_PIN('A',2), TMC2130_PIN('A',3), TMC2130_PIN('A',4), TMC2130_PIN('A',5), // 24
+		TMC2130_PIN('A',6), TMC2130_PIN('A',7), TMC2130_PIN('C',7), TMC2130_PIN('C',6),
+		TMC2130_PIN('C',5), TMC2130_PIN('C',4), TMC2130_PIN('C',3), TMC2130_PIN('C',2), // 32
+		TMC2130_PIN('C',1), TMC2130_PIN('C',0), TMC2130_PIN('D',7), TMC2130_PIN('G',2),
+		TMC2130_PIN('G',1), TMC2130_PIN('G',0), TMC2130_PIN('L',7), TMC2130_PIN('L',6), // 40
+		TMC2130_PIN('L',5), TMC2130_PIN('L',4), TMC2130_PIN('L',3), TMC2130_PIN('L',2),
+		TMC2130_PIN('L',1), TMC2130_PIN('L',0), TMC2130_PIN('B',3), TMC2130_PIN('B',2), // 48
+		TMC2130_PIN('B',1), TMC2130_PIN('B',0), TMC2130_PIN('F',0), TMC2130_PIN('F',1),
+		TMC2130_PIN('F',2), TMC2130_PIN('F',3), TMC2130_PIN('F',4), TMC2130_PIN('F',5), // 56
+		TMC2130_PIN('F',6), TMC2130_PIN('F',7), TMC2130_PIN('K',0), TMC2130_PIN('K',1),
+		TMC2130_PIN('K',2), TMC2130_PIN('K',3), TMC2130_PIN('K',4), TMC2130_PIN('K',5), // 64
+		TMC2130_PIN('K',6), TMC2130_PIN('K',7)
+	};
+	constexpr uint8_t pin_map(uint8_t pin) { return pin < 70 ? mega_pins[pin] : TMC2130_NC; }
+#else
+	constexpr uint8_t pin_map(uint8_t) { return TMC2130_NC; }
+#endif
+
+	// Data space address of PORTx. PINx and DDRx are the two below it.
+	constexpr uint16_t port_address(uint8_t index) {
+		return index < 7 ? 0x22 + 3*index : 0x102 + 3*(index - 7);
+	}
+
+	template<uint8_t PIN>
+	struct pin_t {
+		static constexpr uint8_t 	map 	= pin_map(PIN);
+		static constexpr bool 		fast 	= map != TMC2130_NC;
+		static constexpr uint16_t 	port 	= fast ? port_address(map >> 3) : 0;
+		static constexpr uint8_t 	mask 	= 1 << (map & 0x7);
+		static constexpr bool 		io 		= port < 0x40; // Reachable by sbi/cbi
+
+#if defined(ARDUINO_ARCH_AVR)
+		static inline volatile uint8_t& reg(uint16_t address) __attribute__((always_inline)) {
+			return *(volatile uint8_t *)(uintptr_t)address;
+		}
+		static inline void set(uint16_t address, bool on) __attribute__((always_inline)) {
+			if (io) {
+				if (on) reg(address) |= mask;
+				else 	reg(address) &= ~mask;
+			} else {
+				uint8_t sreg = SREG;
+				cli();
+				if (on) reg(address) |= mask;
+				else 	reg(address) &= ~mask;
+				SREG = sreg;
+			}
+		}
+		static inline void output() __attribute__((always_inline)) {
+			if (fast) set(port - 1, true);
+			else pinMode(PIN, OUTPUT);
+		}
+		static inline void write(bool on) __attribute__((always_inline)) {
+			if (fast) set(port, on);
+			else digitalWrite(PIN, on);
+		}
+		// Writing 1 to PINx toggles the output, no read-modify-write needed
+		static inline void toggle() __attribute__((always_inline)) {
+			if (fast) reg(port - 2) = mask;
+			else digitalWrite(PIN, !digitalRead(PIN));
+		}
+		static inline bool read() __attribute__((always_inline)) {
+			return fast ? reg(port - 2) & mask : digitalRead(PIN);
+		}
+#else
+		static inline void output() 		{ pinMode(PIN, OUTPUT); }
+		static inline void write(bool on) 	{ digitalWrite(PIN, on); }
+		static inline void toggle() 		{ digitalWrite(PIN, !digitalRead(PIN)); }
+		static inline bool read() 			{ return digitalRead(PIN); }
+#endif
+		static inline void high() __attribute__((always_inline)) { write(true); }
+		static inline void low() 	__attribute__((always_inline)) { write(false); }
+	};
+
+	/*
+		Runtime pin. attach() looks up the port register once, so on AVR
+		each access is a load, mask and store instead of digitalWrite()'s
+		table walk. Elsewhere, and on the host, it uses digitalWrite() and
+		digitalRead().
+	*/
+	struct gpio_t {
+		uint8_t pin = TMC2130_NC;
+#if defined(ARDUINO_ARCH_AVR)
+		volatile uint8_t *out = NULL;
+		volatile uint8_t *in = NULL;
+		uint8_t mask = 0;
+
+		void attach(uint8_t p, uint8_t mode) {
+			pin = p;
+			pinMode(pin, mode);
+			out = portOutputRegister(digitalPinToPort(pin));
+			in = portInputRegister(digitalPinToPort(pin));
+			mask = digitalPinToBitMask(pin);
+		}
+		// Not interrupt safe, the caller disables interrupts around a transfer
+		inline void write(bool on) __attribute__((always_inline)) {
+			if (on) *out |= mask;
+			else 	*out &= ~mask;
+		}
+		inline bool read() __attribute__((always_inline)) { return *in & mask; }
+#else
+		void attach(uint8_t p, uint8_t mode) {
+			pin = p;
+			pinMode(pin, mode);
+		}
+		inline void write(bool on) 	{ digitalWrite(pin, on); }
+		inline bool read() 			{ return digitalRead(pin); }
+#endif
+		inline bool attached() 		{ return pin != TMC2130_NC; }
+		inline void high() 			{ write(true); }
+		inline void low() 			{ write(false); }
+	};
+
+	#undef TMC2130_PIN
+	#undef TMC2130_NC
+}
+
+template<uint8_t EN, uint8_t DIR, uint8_t STEP, uint8_t CS>
+class TMC2130StepperT : public TMC2130Stepper {
+	public:
+		typedef TMC2130_fastio::pin_t<EN> 	en_pin;
+		typedef TMC2130_fastio::pin_t<DIR> 	dir_pin;
+		typedef TMC2130_fastio::pin_t<STEP> step_pin;
+		typedef TMC2130_fastio::pin_t<CS> 	cs_pin;
+
+		// The base constructor configures the chip over hardware SPI with
+		// digitalWrite() chip select, everything after that uses cs_pin
+		TMC2130StepperT() : TMC2130Stepper(EN, DIR, STEP, CS) {
+#ifdef ARDUINO
+			bus_backend(transfer);
+#endif
+		}
+
+		inline void step_pulse() 		__attribute__((always_inline)) { step_pin::high(); step_pin::low(); }
+		inline void step_toggle() 		__attribute__((always_inline)) { step_pin::toggle(); } // Use with dedge(true)
+		inline void direction(bool B) 	__attribute__((always_inline)) { dir_pin::write(B); }
+		inline bool direction() 		__attribute__((always_inline)) { return dir_pin::read(); }
+		inline void enable(bool B) 		__attribute__((always_inline)) { en_pin::write(!B); } // EN is active low
+
+	private:
+#ifdef ARDUINO
+		static void transfer(void *, uint8_t *datagram) {
+			SPI.beginTransaction(SPISettings(16000000/8, MSBFIRST, SPI_MODE3));
+			cs_pin::low();
+			for (uint8_t i = 0; i < 5; i++) datagram[i] = SPI.transfer(datagram[i]);
+			cs_pin::high();
+			SPI.endTransaction();
+		}
+#endif
+};
+
+#endif
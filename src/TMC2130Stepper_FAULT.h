@@ -0,0 +1,71 @@
+#ifndef TMC2130Stepper_FAULT_h
+#define TMC2130Stepper_FAULT_h
+
+#include "TMC2130Stepper.h"
+
+#ifndef TMC2130_FAULT_HISTORY
+	#define TMC2130_FAULT_HISTORY 16	// Status entries kept around a fault
+#endif
+#define TMC2130_FAULT_CONFIG 	9		// Registers saved with a fault
+
+// Decoded status flags, also used as trigger mask
+#define FAULT_STALL		0x01
+#define FAULT_OT		0x02
+#define FAULT_OTPW		0x04
+#define FAULT_S2GA		0x08
+#define FAULT_S2GB		0x10
+#define FAULT_OLA		0x20
+#define FAULT_OLB		0x40
+#define FAULT_STST		0x80
+
+struct TMC2130_status_t {
+	uint32_t time;		// ms
+	uint16_t sg_result;
+	uint8_t  cs_actual;
+	uint8_t  flags;		// FAULT_* bits
+};
+
+/*
+	Keeps the last driver status entries in a fixed ring and freezes them
+	when a fault flag in the trigger mask comes up. `post` more entries are
+	recorded after the trigger so the window shows the fault developing.
+	The register configuration is copied from the shadow registers at the
+	trigger. The recording stays frozen until rearm().
+
+	record() does not access the bus and may be called from an interrupt
+	with a DRV_STATUS value read elsewhere. sample() reads DRV_STATUS and
+	records it. While armed, only read the window after frozen() is true.
+	entry() returns an all zero entry past entries(). rearm() is meant for
+	loop(): elsewhere than on AVR it enables interrupts again.
+*/
+class TMC2130FaultRecorder {
+	public:
+		TMC2130FaultRecorder(TMC2130Stepper &driver, uint8_t trigger=FAULT_STALL|FAULT_OT|FAULT_S2GA|FAULT_S2GB, uint8_t post=4);
+		void sample();
+		void record(uint32_t drv_status, uint32_t now);
+		void trigger(uint8_t mask);
+		bool frozen();
+		void rearm();
+		uint8_t entries();
+		const TMC2130_status_t& entry(uint8_t i);
+		uint32_t trigger_time();
+		uint8_t cause();
+		uint8_t config_address(uint8_t i);
+		uint32_t config(uint8_t i);
+
+	private:
+		TMC2130Stepper &drv;
+		TMC2130_status_t history[TMC2130_FAULT_HISTORY];
+		uint32_t snapshot[TMC2130_FAULT_CONFIG];
+		volatile uint8_t head = 0;
+		volatile uint8_t count = 0;
+		volatile uint8_t remaining = 0;		// Entries still to record after the trigger
+		volatile bool triggered = false;
+		volatile bool _frozen = false;
+		uint8_t _trigger;
+		uint8_t _post;
+		uint8_t _cause = 0;
+		uint32_t _trigger_time = 0;
+};
+
+#endif
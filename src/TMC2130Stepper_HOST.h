@@ -0,0 +1,201 @@
+#ifndef TMC2130Stepper_HOST_h
+#define TMC2130Stepper_HOST_h
+
+/*
+	Minimal Arduino environment for building the library on a PC, used
+	when ARDUINO is not defined. Together with a bus backend (see
+	TMC2130Stepper::bus_backend() and extras/simulator) this allows
+	running driver code without hardware.
+
+	Time is virtual. It only moves forward through delay(),
+	delayMicroseconds(), host_advance() and by 1us on every call to
+	micros() or millis(), so busy wait loops terminate.
+
+	digitalWrite() stores the pin level for digitalRead() and calls the
+	hook installed with host_gpio_hook(), which lets a simulator watch
+	the step, direction and enable pins. host_trace() records the writes
+	for checking waveforms, e.g. of the software SPI. Every pin can have
+	an interrupt, its number is the pin number, and the handler runs
+	inside the digitalWrite() that makes the edge.
+*/
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 			1
+#define LOW 			0
+#define INPUT 			0
+#define OUTPUT 			1
+#define INPUT_PULLUP 	2
+#define CHANGE 			1
+#define FALLING 		2
+#define RISING 			3
+#define DEC 			10
+#define HEX 			16
+#define OCT 			8
+#define BIN 			2
+
+#define PROGMEM
+#define F(s) 					(s)
+#define PSTR(s) 				(s)
+#define pgm_read_byte(p) 		(*(const uint8_t *)(p))
+#define pgm_read_word(p) 		(*(const uint16_t *)(p))
+#define pgm_read_dword(p) 		(*(const uint32_t *)(p))
+#define pgm_read_ptr(p) 		(*(void * const *)(p))
+#define memcpy_P 				memcpy
+#define strcmp_P 				strcmp
+#define strlen_P 				strlen
+
+#ifndef min
+	#define min(a,b) 				((a)<(b)?(a):(b))
+	#define max(a,b) 				((a)>(b)?(a):(b))
+#endif
+// abs() is the overload set from <stdlib.h> and <math.h>. A macro would
+// break <cmath> and <cstdlib> included after this file.
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+
+#define HOST_PINS 256
+#define NOT_AN_INTERRUPT -1
+
+typedef void (*host_gpio_hook_t)(void *ctx, uint8_t pin, uint8_t value);
+
+struct host_trace_t {
+	uint32_t 	time_us;
+	uint8_t 	pin;
+	uint8_t 	value;
+};
+
+struct host_state_t {
+	uint32_t 			time_us;
+	uint8_t 			pins[HOST_PINS];
+	host_gpio_hook_t 	hook;
+	void 				*hook_ctx;
+	host_trace_t 		*trace;
+	uint32_t 			trace_size;
+	uint32_t 			trace_count;
+	void 				(*isr[HOST_PINS])();
+	uint8_t 			isr_mode[HOST_PINS];
+};
+
+inline host_state_t& host_state() {
+	static host_state_t state = {};
+	return state;
+}
+
+inline void host_advance(uint32_t us) { host_state().time_us += us; }
+inline void host_time(uint32_t us) { host_state().time_us = us; }
+
+// Installs a pin hook. The previous hook is returned so hooks can be chained.
+inline host_gpio_hook_t host_gpio_hook(host_gpio_hook_t hook, void *ctx, void **prev_ctx=NULL) {
+	host_gpio_hook_t prev = host_state().hook;
+	if (prev_ctx) *prev_ctx = host_state().hook_ctx;
+	host_state().hook = hook;
+	host_state().hook_ctx = ctx;
+	return prev;
+}
+
+// Records every digitalWrite() into buffer until it is full. NULL stops tracing.
+inline void host_trace(host_trace_t *buffer, uint32_t size) {
+	host_state().trace = buffer;
+	host_state().trace_size = size;
+	host_state().trace_count = 0;
+}
+inline uint32_t host_traced() { return host_state().trace_count; }
+
+inline unsigned long micros() { return host_state().time_us++; }
+inline unsigned long millis() { return micros() / 1000; }
+inline void delayMicroseconds(unsigned int us) { host_advance(us); }
+inline void delay(unsigned long ms) { host_advance(ms * 1000); }
+
+// The pull-up makes an input read high until something drives it
+inline void pinMode(uint8_t pin, uint8_t mode) { if (mode == INPUT_PULLUP) host_state().pins[pin] = HIGH; }
+inline int digitalRead(uint8_t pin) { return host_state().pins[pin]; }
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+	host_state_t &s = host_state();
+	uint8_t prev = s.pins[pin];
+	s.pins[pin] = value ? HIGH : LOW;
+	if (s.trace && s.trace_count < s.trace_size) {
+		host_trace_t t = { s.time_us, pin, s.pins[pin] };
+		s.trace[s.trace_count++] = t;
+	}
+	if (s.hook) s.hook(s.hook_ctx, pin, value);
+	if (s.isr[pin] && prev != s.pins[pin]) {
+		uint8_t mode = s.isr_mode[pin];
+		if (mode == CHANGE || (mode == RISING) == (s.pins[pin] == HIGH)) s.isr[pin]();
+	}
+}
+
+inline int digitalPinToInterrupt(uint8_t pin) { return pin; }
+inline void attachInterrupt(uint8_t interrupt, void (*isr)(), int mode) {
+	host_state().isr[interrupt] = isr;
+	host_state().isr_mode[interrupt] = mode;
+}
+inline void detachInterrupt(uint8_t interrupt) { host_state().isr[interrupt] = NULL; }
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+class Print {
+	public:
+		virtual ~Print() {}
+		virtual size_t write(uint8_t c) = 0;
+		virtual size_t write(const uint8_t *buf, size_t n) {
+			for (size_t i = 0; i < n; i++) write(buf[i]);
+			return n;
+		}
+		size_t print(const char *s) 					{ return write((const uint8_t *)s, strlen(s)); }
+		size_t print(char c) 							{ return write((uint8_t)c); }
+		size_t print(unsigned long n, int base=DEC) 	{ return number(n, base, false); }
+		size_t print(long n, int base=DEC) 				{ return number(n, base, base == DEC && n < 0); }
+		size_t print(unsigned int n, int base=DEC) 		{ return print((unsigned long)n, base); }
+		size_t print(int n, int base=DEC) 				{ return print((long)n, base); }
+		size_t print(unsigned char n, int base=DEC) 	{ return print((unsigned long)n, base); }
+		size_t print(double d, int digits=2) 			{ char b[32]; snprintf(b, sizeof(b), "%.*f", digits, d); return print(b); }
+		size_t println() 								{ return print("\r\n"); }
+		template<typename T> size_t println(T v) 		{ return print(v) + println(); }
+		template<typename T> size_t println(T v, int f) { return print(v, f) + println(); }
+
+	private:
+		size_t number(unsigned long n, int base, bool negative) {
+			char buf[8*sizeof(long)+2];
+			char *p = &buf[sizeof(buf)-1];
+			*p = '\0';
+			if (negative) n = -(long)n;
+			if (base < 2) base = DEC;
+			do {
+				uint8_t d = n % base;
+				*--p = d < 10 ? '0'+d : 'A'+d-10;
+				n /= base;
+			} while (n);
+			if (negative) *--p = '-';
+			return print(p);
+		}
+};
+
+class Stream : public Print {
+	public:
+		virtual int available() = 0;
+		virtual int read() = 0;
+		virtual int peek() { return -1; }
+};
+
+// Serial prints to stdout and never receives anything. The one instance
+// is defined in TMC2130Stepper_HOST.cpp.
+class HostSerial : public Stream {
+	public:
+		void begin(unsigned long) {}
+		operator bool() { return true; }
+		size_t write(uint8_t c) { return fputc(c, stdout) == EOF ? 0 : 1; }
+		int available() { return 0; }
+		int read() { return -1; }
+};
+extern HostSerial Serial;
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TMC2130Stepper_MICROSTEP_h
+#define TMC2130Stepper_MICROSTEP_h
+
+#include "TMC2130Stepper.h"
+
+#ifndef TMC2130_MICROSTEP_LEVELS
+	#define TMC2130_MICROSTEP_LEVELS 4
+#endif
+
+/*
+	Lowers the microstep resolution at speed, so fewer STEP pulses are
+	needed for the same motion.
+
+	The resolution set when begin() is called is the base, used below the
+	first threshold. add() configures coarser resolutions for the speeds
+	above, in fullsteps/s. update(), called from loop() with the current
+	speed, selects one with `hysteresis` percent on the way down.
+
+	The switch itself happens in step(), called from the step generator
+	after each STEP pulse and before the next. Changing MRES only changes
+	the MSCNT increment per pulse, so the switch to a coarser resolution
+	waits for a pulse that leaves MSCNT on the coarser grid: a multiple of
+	256/microsteps, or 128 + n*256 (the 45 degree positions) for fullstep.
+	To find it, MSCNT is read on two consecutive pulses, which gives the
+	position and the direction. The following pulses are counted without
+	bus access. Switching to a finer resolution is always aligned and
+	happens on the next pulse. Each switch writes CHOPCONF once.
+
+	step() returns the new divider on the pulse that switched, else 0.
+	The divider is the number of base microsteps per pulse: from the next
+	pulse on, the generator divides its step rate by the divider and adds
+	the divider to its position, which stays in base microsteps.
+
+	While a switch to a coarser resolution is pending, the direction must
+	not change. step() does nothing while it finds the bus taken and tries
+	again on a later pulse.
+*/
+class TMC2130Microstep {
+	public:
+		TMC2130Microstep(TMC2130Stepper &driver);
+		bool add(uint16_t fullsteps_per_s, uint16_t microsteps);
+		void hysteresis(uint8_t percent);
+		bool begin(bool interpolate=true);
+		void update(uint16_t fullsteps_per_s);
+		uint16_t step();
+		void fullstep_above(uint16_t fullsteps_per_s, bool constant_off_time=false);
+		uint16_t microsteps();
+		uint16_t divider();
+		bool pending();
+		uint32_t switches();
+
+	private:
+		enum { IDLE, PROBE, TRACK };
+		struct level_t {
+			uint16_t 	speed;		// fullsteps/s
+			uint8_t 	mres;
+		};
+		uint16_t switch_to(uint8_t level);
+
+		TMC2130Stepper &drv;
+		level_t levels[TMC2130_MICROSTEP_LEVELS+1];	// [0] is the base resolution
+		uint8_t count = 0;
+		uint8_t _hysteresis = 10;
+		volatile uint8_t target = 0;
+		volatile uint8_t current = 0;
+		uint8_t phase = IDLE;
+		int8_t 	dir = 0;
+		uint16_t mscnt = 0;
+		uint32_t _switches = 0;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef TMC2130Stepper_PROTOCOL_h
+#define TMC2130Stepper_PROTOCOL_h
+
+#include "TMC2130Stepper.h"
+
+#define TMC2130_PROTO_SYNC		0xA5
+#define TMC2130_PROTO_FRAME		8	// sync, cmd, id, 4 byte value (MSB first), crc8
+#define TMC2130_PROTO_LINE		32	// Longest text command including the argument
+
+// Binary commands. A reply carries the command with TMC2130_PROTO_OK or
+// TMC2130_PROTO_ERR or'ed in and the resulting value.
+#define TMC2130_PROTO_SET		0x01
+#define TMC2130_PROTO_GET		0x02
+#define TMC2130_PROTO_COUNT		0x03	// Number of parameters in the table
+#define TMC2130_PROTO_OK		0x80
+#define TMC2130_PROTO_ERR		0x40
+
+/*
+	Tuning and telemetry protocol on top of any Stream.
+
+	Text mode:		"<name> <value>\n" sets a parameter, "<name>\n" reads it.
+					The reply is "<name> <value>\n".
+	Binary mode:	Fixed 8 byte frames starting with TMC2130_PROTO_SYNC.
+					Parameters are addressed by their index in the table,
+					see TMC2130Stepper_PROTOCOL.cpp. The table is append only
+					so ids stay stable between library versions.
+					A frame failing the CRC gets no reply. The parser
+					slides to the next sync byte inside it and goes on.
+
+	Both modes are parsed in place in fixed buffers, nothing is allocated.
+	poll() only handles the bytes already received and never waits.
+	encode() and decode() build and check frames on the host side,
+	extras/protocol/protocol.py does the same from Python.
+*/
+class TMC2130Protocol {
+	public:
+		typedef bool (*handler_t)(const char *cmd, int32_t arg, bool has_arg, Print &out);
+
+		TMC2130Protocol(TMC2130Stepper &driver);
+		void poll(Stream &io, uint8_t max_bytes=TMC2130_PROTO_LINE);
+		void feed(uint8_t c, Print &out);
+		void unknown(handler_t handler);
+
+		static uint8_t params();
+		static int16_t find(const char *name);
+		static bool name(uint8_t id, char *buf, uint8_t len);
+		static bool writable(uint8_t id);
+		static void encode(uint8_t *frame, uint8_t cmd, uint8_t id, int32_t value);
+		static bool decode(const uint8_t *frame, uint8_t &cmd, uint8_t &id, int32_t &value);
+		static uint8_t crc8(const uint8_t *data, uint8_t len);
+
+	private:
+		void execute_text(Print &out);
+		bool execute_binary(Print &out);
+		void resync();
+		bool set(uint8_t id, int32_t value);
+		bool get(uint8_t id, int32_t &value);
+
+		TMC2130Stepper &drv;
+		handler_t fallback = NULL;
+		char line[TMC2130_PROTO_LINE+1];
+		uint8_t frame[TMC2130_PROTO_FRAME];
+		uint8_t pos = 0;
+		bool binary = false;
+		bool overflow = false;
+};
+
+#endif
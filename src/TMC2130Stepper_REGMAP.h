@@ -0,0 +1,359 @@
+#ifndef TMC2130Stepper_REGMAP_h
+#define TMC2130Stepper_REGMAP_h
+
+#include <stdint.h>
+#include "TMC2130Stepper_REGDEFS.h"
+
+/*
+	Register map as one descriptor table.
+
+	Every register is described by reg_t<address, access, implemented bits>
+	and every field by one row of the field table below, which becomes a
+	field_t<register, shift, width, signed>. The field accessors get() and
+	set() are constexpr and compile down to a single shift and mask. The
+	same rows generate the FIELD_bp/FIELD_bm constants and the field
+	accessors of TMC2130Stepper, so a field is only described here. The
+	register macros in TMC2130Stepper_MACROS.h are built on these
+	descriptors, and the static_asserts at the end of the namespace check
+	the table for overlapping fields and signed round trips.
+*/
+namespace TMC2130_n {
+
+	enum access_t {
+		R 	= 0x1,
+		W 	= 0x2,
+		C 	= 0x4,		// Flags are cleared by writing 1
+		RW 	= R|W,
+		RWC = R|W|C
+	};
+
+	// <type_traits> is not available on AVR
+	template<bool COND, typename T, typename F> struct select_t 				{ typedef T type; };
+	template<typename T, typename F> 			struct select_t<false, T, F> 	{ typedef F type; };
+
+	template<uint8_t WIDTH, bool SIGNED> struct value_t {
+		typedef typename select_t<WIDTH == 1, bool,
+				typename select_t<WIDTH <= 8, uint8_t,
+				typename select_t<WIDTH <= 16, uint16_t, uint32_t>::type>::type>::type type;
+	};
+	template<uint8_t WIDTH> struct value_t<WIDTH, true> {
+		typedef typename select_t<WIDTH <= 8, int8_t,
+				typename select_t<WIDTH <= 16, int16_t, int32_t>::type>::type type;
+	};
+
+	constexpr uint32_t ones(uint8_t width) { return width >= 32 ? 0xFFFFFFFFUL : (1UL << width) - 1; }
+	constexpr uint8_t popcount(uint32_t v) { return v ? (v & 1) + popcount(v >> 1) : 0; }
+
+	// Two's complement field of `width` bits to int32_t without branching:
+	// flipping the sign bit and subtracting it again borrows through the upper bits.
+	constexpr int32_t sign_extend(uint32_t raw, uint8_t width) {
+		return (int32_t)(raw ^ (1UL << (width - 1))) - (int32_t)(1UL << (width - 1));
+	}
+
+	template<uint8_t ADDRESS, uint8_t ACCESS, uint32_t MASK>
+	struct reg_t {
+		static constexpr uint8_t 	address 	= ADDRESS;
+		static constexpr uint8_t 	access 		= ACCESS;
+		static constexpr uint32_t 	mask 		= MASK;		// Implemented bits
+		static constexpr bool 		readable 	= ACCESS & R;
+		static constexpr bool 		writable 	= ACCESS & W;
+	};
+
+	template<typename REG, uint8_t SHIFT, uint8_t WIDTH, bool SIGNED=false>
+	struct field_t {
+		typedef REG reg;
+		typedef typename value_t<WIDTH, SIGNED>::type type;
+		static constexpr uint8_t 	shift 		= SHIFT;
+		static constexpr uint8_t 	width 		= WIDTH;
+		static constexpr bool 		is_signed 	= SIGNED;
+		static constexpr uint32_t 	mask 		= ones(WIDTH) << SHIFT;
+		static constexpr int32_t 	min 		= SIGNED ? -(int32_t)(1UL << (WIDTH - 1)) : 0;
+		static constexpr uint32_t 	max 		= SIGNED ? ones(WIDTH - 1) : ones(WIDTH);
+
+		static constexpr uint32_t 	raw(uint32_t sr) 				{ return (sr >> SHIFT) & ones(WIDTH); }
+		static constexpr type 		get(uint32_t sr) 				{ return SIGNED ? sign_extend(raw(sr), WIDTH) : raw(sr); }
+		// Negative values are masked down to their two's complement bits
+		static constexpr uint32_t 	set(uint32_t sr, uint32_t value){ return (sr & ~mask) | ((value << SHIFT) & mask); }
+
+		static_assert(SHIFT + WIDTH <= 32, "Field does not fit in 32 bits");
+		static_assert(!SIGNED || WIDTH > 1, "A signed field needs at least two bits");
+		static_assert((mask & ~REG::mask) == 0, "Field outside of the implemented register bits");
+	};
+
+	// View of a field whose register value is stored with an offset,
+	// e.g. HEND 0..15 stands for -3..12 and HSTRT 0..7 for 1..8
+	template<typename FIELD, int8_t OFFSET>
+	struct offset_t {
+		typedef FIELD field;
+		static constexpr int8_t 	offset 	= OFFSET;
+		static constexpr int32_t 	min 	= FIELD::min + OFFSET;
+		static constexpr int32_t 	max 	= (int32_t)FIELD::max + OFFSET;
+
+		static constexpr int16_t 	get(uint32_t sr) 				{ return (int16_t)FIELD::get(sr) + OFFSET; }
+		static constexpr uint32_t 	set(uint32_t sr, int16_t value) { return FIELD::set(sr, value - OFFSET); }
+	};
+
+	// Registers 	 	 address 			access 	implemented bits
+	typedef reg_t<REG_GCONF, 		RW, 	0x0003FFFFUL> GCONF_r;
+	typedef reg_t<REG_GSTAT, 		RWC, 	0x00000007UL> GSTAT_r;
+	typedef reg_t<REG_IOIN, 		R, 		0xFF00003FUL> IOIN_r;
+	typedef reg_t<REG_IHOLD_IRUN, 	W, 		0x000F1F1FUL> IHOLD_IRUN_r;
+	typedef reg_t<REG_TPOWERDOWN, 	W, 		0x000000FFUL> TPOWERDOWN_r;
+	typedef reg_t<REG_TSTEP, 		R, 		0x000FFFFFUL> TSTEP_r;
+	typedef reg_t<REG_TPWMTHRS, 	W, 		0x000FFFFFUL> TPWMTHRS_r;
+	typedef reg_t<REG_TCOOLTHRS, 	W, 		0x000FFFFFUL> TCOOLTHRS_r;
+	typedef reg_t<REG_THIGH, 		W, 		0x000FFFFFUL> THIGH_r;
+	typedef reg_t<REG_XDIRECT, 		RW, 	0x01FF01FFUL> XDIRECT_r;
+	typedef reg_t<REG_VDCMIN, 		W, 		0x007FFFFFUL> VDCMIN_r;
+	typedef reg_t<REG_MSLUT0, 		W, 		0xFFFFFFFFUL> MSLUT0_r;
+	typedef reg_t<REG_MSLUT1, 		W, 		0xFFFFFFFFUL> MSLUT1_r;
+	typedef reg_t<REG_MSLUT2, 		W, 		0xFFFFFFFFUL> MSLUT2_r;
+	typedef reg_t<REG_MSLUT3, 		W, 		0xFFFFFFFFUL> MSLUT3_r;
+	typedef reg_t<REG_MSLUT4, 		W, 		0xFFFFFFFFUL> MSLUT4_r;
+	typedef reg_t<REG_MSLUT5, 		W, 		0xFFFFFFFFUL> MSLUT5_r;
+	typedef reg_t<REG_MSLUT6, 		W, 		0xFFFFFFFFUL> MSLUT6_r;
+	typedef reg_t<REG_MSLUT7, 		W, 		0xFFFFFFFFUL> MSLUT7_r;
+	typedef reg_t<REG_MSLUTSEL, 	W, 		0xFFFFFFFFUL> MSLUTSEL_r;
+	typedef reg_t<REG_MSLUTSTART, 	W, 		0x00FF00FFUL> MSLUTSTART_r;
+	typedef reg_t<REG_MSCNT, 		R, 		0x000003FFUL> MSCNT_r;
+	typedef reg_t<REG_MSCURACT, 	R, 		0x01FF01FFUL> MSCURACT_r;
+	typedef reg_t<REG_CHOPCONF, 	RW, 	0x7FFFFFFFUL> CHOPCONF_r;
+	typedef reg_t<REG_COOLCONF, 	W, 		0x017FEF6FUL> COOLCONF_r;
+	typedef reg_t<REG_DCCTRL, 		W, 		0x00FF03FFUL> DCCTRL_r;
+	typedef reg_t<REG_DRV_STATUS, 	R, 		0xFF1F83FFUL> DRV_STATUS_r;
+	typedef reg_t<REG_PWMCONF, 		W, 		0x003FFFFFUL> PWMCONF_r;
+	typedef reg_t<REG_PWM_SCALE, 	R, 		0x000000FFUL> PWM_SCALE_r;
+	typedef reg_t<REG_ENCM_CTRL, 	W, 		0x00000003UL> ENCM_CTRL_r;
+	typedef reg_t<REG_LOST_STEPS, 	R, 		0x000FFFFFUL> LOST_STEPS_r;
+
+	/*
+		Field table, one row per field:
+		F(kind, register, FIELD, accessor, shift, width, signed)
+
+		kind	RW 		get and set accessor in TMC2130Stepper
+				R 		get accessor only
+				X 		no accessor, e.g. single value registers
+				ALIAS 	second view of bits covered by another row
+
+		Each row gives FIELD_f below, the FIELD_bp/FIELD_bm constants after
+		the namespace and, for RW and R rows, the TMC2130Stepper member
+		functions `accessor`, typed after the field width and signedness.
+	*/
+	#define TMC2130_GCONF_FIELDS(F) \
+		F(RW, 	GCONF, 		I_SCALE_ANALOG, 		I_scale_analog, 		 0, 1, false) \
+		F(RW, 	GCONF, 		INTERNAL_RSENSE, 		internal_Rsense, 		 1, 1, false) \
+		F(RW, 	GCONF, 		EN_PWM_MODE, 			en_pwm_mode, 			 2, 1, false) \
+		F(RW, 	GCONF, 		ENC_COMMUTATION, 		enc_commutation, 		 3, 1, false) \
+		F(RW, 	GCONF, 		SHAFT, 					shaft, 					 4, 1, false) \
+		F(RW, 	GCONF, 		DIAG0_ERROR, 			diag0_error, 			 5, 1, false) \
+		F(RW, 	GCONF, 		DIAG0_OTPW, 			diag0_otpw, 			 6, 1, false) \
+		F(RW, 	GCONF, 		DIAG0_STALL, 			diag0_stall, 			 7, 1, false) \
+		F(RW, 	GCONF, 		DIAG1_STALL, 			diag1_stall, 			 8, 1, false) \
+		F(RW, 	GCONF, 		DIAG1_INDEX, 			diag1_index, 			 9, 1, false) \
+		F(RW, 	GCONF, 		DIAG1_ONSTATE, 			diag1_onstate, 			10, 1, false) \
+		F(RW, 	GCONF, 		DIAG1_STEPS_SKIPPED, 	diag1_steps_skipped, 	11, 1, false) \
+		F(RW, 	GCONF, 		DIAG0_INT_PUSHPULL, 	diag0_int_pushpull, 	12, 1, false) \
+		F(RW, 	GCONF, 		DIAG1_PUSHPULL, 		diag1_pushpull, 		13, 1, false) \
+		F(RW, 	GCONF, 		SMALL_HYSTERISIS, 		small_hysterisis, 		14, 1, false) \
+		F(RW, 	GCONF, 		STOP_ENABLE, 			stop_enable, 			15, 1, false) \
+		F(RW, 	GCONF, 		DIRECT_MODE, 			direct_mode, 			16, 1, false) \
+		F(X, 	GCONF, 		TEST_MODE, 				-, 						17, 1, false)
+	#define TMC2130_GSTAT_FIELDS(F) \
+		F(R, 	GSTAT, 		RESET, 					reset, 					 0, 1, false) \
+		F(R, 	GSTAT, 		DRV_ERR, 				drv_err, 				 1, 1, false) \
+		F(R, 	GSTAT, 		UV_CP, 					uv_cp, 					 2, 1, false)
+	#define TMC2130_IOIN_FIELDS(F) \
+		F(R, 	IOIN, 		STEP, 					step, 					 0, 1, false) \
+		F(R, 	IOIN, 		DIR, 					dir, 					 1, 1, false) \
+		F(R, 	IOIN, 		DCEN_CFG4, 				dcen_cfg4, 				 2, 1, false) \
+		F(R, 	IOIN, 		DCIN_CFG5, 				dcin_cfg5, 				 3, 1, false) \
+		F(R, 	IOIN, 		DRV_ENN_CFG6, 			drv_enn_cfg6, 			 4, 1, false) \
+		F(R, 	IOIN, 		DCO, 					dco, 					 5, 1, false) \
+		F(R, 	IOIN, 		VERSION, 				version, 				24, 8, false)
+	#define TMC2130_IHOLD_IRUN_FIELDS(F) \
+		F(RW, 	IHOLD_IRUN, IHOLD, 					ihold, 					 0, 5, false) \
+		F(RW, 	IHOLD_IRUN, IRUN, 					irun, 					 8, 5, false) \
+		F(RW, 	IHOLD_IRUN, IHOLDDELAY, 			iholddelay, 			16, 4, false)
+	#define TMC2130_VALUE_FIELDS(F) \
+		F(X, 	TPOWERDOWN, TPOWERDOWN, 			-, 						 0, 8, false) \
+		F(X, 	TSTEP, 		TSTEP, 					-, 						 0, 20, false) \
+		F(X, 	TPWMTHRS, 	TPWMTHRS, 				-, 						 0, 20, false) \
+		F(X, 	TCOOLTHRS, 	TCOOLTHRS, 				-, 						 0, 20, false) \
+		F(X, 	THIGH, 		THIGH, 					-, 						 0, 20, false) \
+		F(X, 	VDCMIN, 	VDCMIN, 				-, 						 0, 23, false) \
+		F(X, 	MSLUT0, 	MSLUT0, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT1, 	MSLUT1, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT2, 	MSLUT2, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT3, 	MSLUT3, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT4, 	MSLUT4, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT5, 	MSLUT5, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT6, 	MSLUT6, 				-, 						 0, 32, false) \
+		F(X, 	MSLUT7, 	MSLUT7, 				-, 						 0, 32, false) \
+		F(X, 	MSLUTSEL, 	MSLUTSEL, 				-, 						 0, 32, false) \
+		F(X, 	MSCNT, 		MSCNT, 					-, 						 0, 10, false) \
+		F(X, 	PWM_SCALE, 	PWM_SCALE, 				-, 						 0, 8, false) \
+		F(X, 	LOST_STEPS, LOST_STEPS, 			-, 						 0, 20, false)
+	#define TMC2130_XDIRECT_FIELDS(F) \
+		F(RW, 	XDIRECT, 	COIL_A, 				coil_A, 				 0, 9, true) \
+		F(RW, 	XDIRECT, 	COIL_B, 				coil_B, 				16, 9, true)
+	#define TMC2130_MSLUTSTART_FIELDS(F) \
+		F(X, 	MSLUTSTART, START_SIN, 				-, 						 0, 8, false) \
+		F(X, 	MSLUTSTART, START_SIN90, 			-, 						16, 8, false)
+	#define TMC2130_MSCURACT_FIELDS(F) \
+		F(X, 	MSCURACT, 	CUR_A, 					-, 						 0, 9, true) \
+		F(X, 	MSCURACT, 	CUR_B, 					-, 						16, 9, true)
+	#define TMC2130_CHOPCONF_FIELDS(F) \
+		F(RW, 	CHOPCONF, 	TOFF, 					toff, 					 0, 4, false) \
+		F(RW, 	CHOPCONF, 	HSTRT, 					hstrt, 					 4, 3, false) /* chm=0 */ \
+		F(ALIAS,CHOPCONF, 	TFD, 					-, 						 4, 3, false) /* chm=1, fast decay time bits 0..2 */ \
+		F(RW, 	CHOPCONF, 	HEND, 					hend, 					 7, 4, false) /* chm=1: OFFSET */ \
+		F(X, 	CHOPCONF, 	FD3, 					-, 						11, 1, false) /* chm=1, fast decay time bit 3 */ \
+		F(RW, 	CHOPCONF, 	DISFDCC, 				disfdcc, 				12, 1, false) \
+		F(RW, 	CHOPCONF, 	RNDTF, 					rndtf, 					13, 1, false) \
+		F(RW, 	CHOPCONF, 	CHM, 					chm, 					14, 1, false) \
+		F(RW, 	CHOPCONF, 	TBL, 					tbl, 					15, 2, false) \
+		F(RW, 	CHOPCONF, 	VSENSE, 				vsense, 				17, 1, false) \
+		F(RW, 	CHOPCONF, 	VHIGHFS, 				vhighfs, 				18, 1, false) \
+		F(RW, 	CHOPCONF, 	VHIGHCHM, 				vhighchm, 				19, 1, false) \
+		F(RW, 	CHOPCONF, 	SYNC, 					sync, 					20, 4, false) \
+		F(RW, 	CHOPCONF, 	MRES, 					mres, 					24, 4, false) \
+		F(RW, 	CHOPCONF, 	INTPOL, 				intpol, 				28, 1, false) \
+		F(RW, 	CHOPCONF, 	DEDGE, 					dedge, 					29, 1, false) \
+		F(RW, 	CHOPCONF, 	DISS2G, 				diss2g, 				30, 1, false)
+	#define TMC2130_COOLCONF_FIELDS(F) \
+		F(RW, 	COOLCONF, 	SEMIN, 					semin, 					 0, 4, false) \
+		F(RW, 	COOLCONF, 	SEUP, 					seup, 					 5, 2, false) \
+		F(RW, 	COOLCONF, 	SEMAX, 					semax, 					 8, 4, false) \
+		F(RW, 	COOLCONF, 	SEDN, 					sedn, 					13, 2, false) \
+		F(RW, 	COOLCONF, 	SEIMIN, 				seimin, 				15, 1, false) \
+		F(RW, 	COOLCONF, 	SGT, 					sgt, 					16, 7, true) \
+		F(RW, 	COOLCONF, 	SFILT, 					sfilt, 					24, 1, false)
+	#define TMC2130_DCCTRL_FIELDS(F) \
+		F(RW, 	DCCTRL, 	DC_TIME, 				dc_time, 				 0, 10, false) \
+		F(RW, 	DCCTRL, 	DC_SG, 					dc_sg, 					16, 8, false)
+	#define TMC2130_DRV_STATUS_FIELDS(F) \
+		F(R, 	DRV_STATUS, SG_RESULT, 				sg_result, 				 0, 10, false) \
+		F(R, 	DRV_STATUS, FSACTIVE, 				fsactive, 				15, 1, false) \
+		F(R, 	DRV_STATUS, CS_ACTUAL, 				cs_actual, 				16, 5, false) \
+		F(R, 	DRV_STATUS, STALLGUARD, 			stallguard, 			24, 1, false) \
+		F(R, 	DRV_STATUS, OT, 					ot, 					25, 1, false) \
+		F(R, 	DRV_STATUS, OTPW, 					otpw, 					26, 1, false) \
+		F(R, 	DRV_STATUS, S2GA, 					s2ga, 					27, 1, false) \
+		F(R, 	DRV_STATUS, S2GB, 					s2gb, 					28, 1, false) \
+		F(R, 	DRV_STATUS, OLA, 					ola, 					29, 1, false) \
+		F(R, 	DRV_STATUS, OLB, 					olb, 					30, 1, false) \
+		F(R, 	DRV_STATUS, STST, 					stst, 					31, 1, false)
+	#define TMC2130_PWMCONF_FIELDS(F) \
+		F(RW, 	PWMCONF, 	PWM_AMPL, 				pwm_ampl, 				 0, 8, false) \
+		F(RW, 	PWMCONF, 	PWM_GRAD, 				pwm_grad, 				 8, 8, false) \
+		F(RW, 	PWMCONF, 	PWM_FREQ, 				pwm_freq, 				16, 2, false) \
+		F(RW, 	PWMCONF, 	PWM_AUTOSCALE, 			pwm_autoscale, 			18, 1, false) \
+		F(RW, 	PWMCONF, 	PWM_SYMMETRIC, 			pwm_symmetric, 			19, 1, false) \
+		F(RW, 	PWMCONF, 	FREEWHEEL, 				freewheel, 				20, 2, false)
+	#define TMC2130_ENCM_CTRL_FIELDS(F) \
+		F(RW, 	ENCM_CTRL, 	INV, 					inv, 					 0, 1, false) \
+		F(RW, 	ENCM_CTRL, 	MAXSPEED, 				maxspeed, 				 1, 1, false)
+
+	// Registers with more than one field
+	#define TMC2130_FIELD_REGISTERS(R) \
+		R(GCONF) R(GSTAT) R(IOIN) R(IHOLD_IRUN) R(XDIRECT) R(MSLUTSTART) R(MSCURACT) \
+		R(CHOPCONF) R(COOLCONF) R(DCCTRL) R(DRV_STATUS) R(PWMCONF) R(ENCM_CTRL)
+
+	#define TMC2130_FIELDS(F) \
+		TMC2130_GCONF_FIELDS(F) TMC2130_GSTAT_FIELDS(F) TMC2130_IOIN_FIELDS(F) \
+		TMC2130_IHOLD_IRUN_FIELDS(F) TMC2130_VALUE_FIELDS(F) TMC2130_XDIRECT_FIELDS(F) \
+		TMC2130_MSLUTSTART_FIELDS(F) TMC2130_MSCURACT_FIELDS(F) TMC2130_CHOPCONF_FIELDS(F) \
+		TMC2130_COOLCONF_FIELDS(F) TMC2130_DCCTRL_FIELDS(F) TMC2130_DRV_STATUS_FIELDS(F) \
+		TMC2130_PWMCONF_FIELDS(F) TMC2130_ENCM_CTRL_FIELDS(F)
+
+	#define TMC2130_FIELD_TYPE(KIND, REG, FIELD, NAME, SHIFT, WIDTH, SIGNED) \
+		typedef field_t<REG##_r, SHIFT, WIDTH, SIGNED> FIELD##_f;
+	TMC2130_FIELDS(TMC2130_FIELD_TYPE)
+	#undef TMC2130_FIELD_TYPE
+
+	// Offset views
+	typedef offset_t<HSTRT_f, 1> 	HYSTERESIS_START_v;
+	typedef offset_t<HEND_f, -3> 	HYSTERESIS_END_v;
+
+	// Every implemented bit is covered exactly once, aliases aside
+	#define TMC2130_MASK_RW(F) 		| F##_f::mask
+	#define TMC2130_MASK_R(F) 		| F##_f::mask
+	#define TMC2130_MASK_X(F) 		| F##_f::mask
+	#define TMC2130_MASK_ALIAS(F)
+	#define TMC2130_MASK(KIND, REG, FIELD, ...) 	TMC2130_MASK_##KIND(FIELD)
+	#define TMC2130_WIDTH_RW(F) 	+ F##_f::width
+	#define TMC2130_WIDTH_R(F) 		+ F##_f::width
+	#define TMC2130_WIDTH_X(F) 		+ F##_f::width
+	#define TMC2130_WIDTH_ALIAS(F)
+	#define TMC2130_WIDTH(KIND, REG, FIELD, ...) 	TMC2130_WIDTH_##KIND(FIELD)
+	#define TMC2130_LAYOUT(REG) \
+		static_assert(popcount(0 TMC2130_##REG##_FIELDS(TMC2130_MASK)) == 0 TMC2130_##REG##_FIELDS(TMC2130_WIDTH), #REG " fields overlap"); \
+		static_assert((0 TMC2130_##REG##_FIELDS(TMC2130_MASK)) == REG##_r::mask, #REG " fields do not cover the register");
+
+	TMC2130_FIELD_REGISTERS(TMC2130_LAYOUT)
+	#undef TMC2130_LAYOUT
+	#undef TMC2130_MASK_RW
+	#undef TMC2130_MASK_R
+	#undef TMC2130_MASK_X
+	#undef TMC2130_MASK_ALIAS
+	#undef TMC2130_MASK
+	#undef TMC2130_WIDTH_RW
+	#undef TMC2130_WIDTH_R
+	#undef TMC2130_WIDTH_X
+	#undef TMC2130_WIDTH_ALIAS
+	#undef TMC2130_WIDTH
+
+	static_assert(TFD_f::mask == HSTRT_f::mask, "TFD is the chm=1 view of the HSTRT bits");
+
+	// Round trip of every signed and offset field at its limits. Neighbouring
+	// bits must survive the write.
+	template<typename F> constexpr bool round_trip(int32_t v) {
+		return F::get(F::set(0, v)) == v
+			&& F::get(F::set(0xFFFFFFFFUL, v)) == v
+			&& (F::set(0, v) & ~F::field::mask) == 0
+			&& (F::set(0xFFFFFFFFUL, v) | F::field::mask) == 0xFFFFFFFFUL;
+	}
+	template<typename V> constexpr bool round_trip_range() {
+		return round_trip<V>(V::min) && round_trip<V>(V::min + 1) && round_trip<V>((V::min + (int32_t)V::max) / 2)
+			&& round_trip<V>((int32_t)V::max - 1) && round_trip<V>(V::max);
+	}
+	template<typename F> struct as_view { // Lets plain fields use round_trip()
+		typedef F field;
+		static constexpr int32_t 	min = F::min;
+		static constexpr int32_t 	max = F::max;
+		static constexpr typename F::type 	get(uint32_t sr) 				{ return F::get(sr); }
+		static constexpr uint32_t 			set(uint32_t sr, int32_t value) { return F::set(sr, value); }
+	};
+	#define TMC2130_ROUND_TRIP(V) static_assert(round_trip_range<V>(), #V " does not survive a round trip");
+
+	TMC2130_ROUND_TRIP(as_view<SGT_f>)
+	TMC2130_ROUND_TRIP(as_view<COIL_A_f>)
+	TMC2130_ROUND_TRIP(as_view<COIL_B_f>)
+	TMC2130_ROUND_TRIP(as_view<CUR_A_f>)
+	TMC2130_ROUND_TRIP(as_view<CUR_B_f>)
+	TMC2130_ROUND_TRIP(HYSTERESIS_START_v)
+	TMC2130_ROUND_TRIP(HYSTERESIS_END_v)
+	#undef TMC2130_ROUND_TRIP
+
+	static_assert(SGT_f::get(0x003F0000UL) == 63 && SGT_f::get(0x00400000UL) == -64 && SGT_f::get(0x007F0000UL) == -1, "SGT sign extension");
+	static_assert(COIL_B_f::get(0x00FF0000UL) == 255 && COIL_B_f::get(0x01010000UL) == -255, "COIL_B sign extension");
+	static_assert(SGT_f::set(0, -64) == 0x00400000UL && COIL_A_f::set(0, -1) == 0x1FFUL, "Signed fields store two's complement");
+	static_assert(HYSTERESIS_END_v::get(0) == -3 && HYSTERESIS_END_v::set(0, 12) == HEND_f::mask, "HEND offset");
+}
+
+// _bp/_bm constants of every field, and of the registers with several fields
+#define TMC2130_FIELD_CONSTANTS(KIND, REG, FIELD, NAME, SHIFT, WIDTH, SIGNED) \
+	constexpr uint8_t 	FIELD##_bp = SHIFT; \
+	constexpr uint32_t 	FIELD##_bm = TMC2130_n::FIELD##_f::mask;
+#define TMC2130_REGISTER_CONSTANTS(REG) \
+	constexpr uint8_t 	REG##_bp = 0; \
+	constexpr uint32_t 	REG##_bm = TMC2130_n::REG##_r::mask;
+TMC2130_FIELDS(TMC2130_FIELD_CONSTANTS)
+TMC2130_FIELD_REGISTERS(TMC2130_REGISTER_CONSTANTS)
+#undef TMC2130_FIELD_CONSTANTS
+#undef TMC2130_REGISTER_CONSTANTS
+
+constexpr uint8_t 	FD_bp = TFD_bp;
+constexpr uint32_t 	FD_bm = TFD_bm | FD3_bm;	// TFD bits 4..6 and fd3 bit 11
+
+#endif
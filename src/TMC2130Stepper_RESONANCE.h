@@ -0,0 +1,61 @@
+#ifndef TMC2130Stepper_RESONANCE_h
+#define TMC2130Stepper_RESONANCE_h
+
+#include "TMC2130Stepper.h"
+
+#ifndef TMC2130_RESONANCE_BINS
+	#define TMC2130_RESONANCE_BINS 32
+#endif
+
+// Load signature of one speed bin, 8 bytes
+struct TMC2130_resonance_bin_t {
+	uint16_t 	sg;			// SG_RESULT mean
+	uint16_t 	sg_dev;		// SG_RESULT standard deviation
+	uint8_t 	pwm;		// PWM_SCALE mean
+	uint8_t 	cs;			// CS_ACTUAL mean
+	uint8_t 	stalls;		// Samples with the stallGuard flag set
+	bool 		resonant;
+};
+
+/*
+	Maps the speed bands where an axis resonates.
+
+	map() steps through a speed range in equal bins. The motor runs at the
+	centre speed of each bin while DRV_STATUS and PWM_SCALE are sampled.
+	A bin is marked resonant when, compared to the median of up to two
+	bins on either side:
+	- the mean SG_RESULT drops by more than `drop_percent` (load peak)
+	- the SG_RESULT deviation is more than twice as high (vibration)
+	- PWM_SCALE rises by more than `pwm_rise` (stealthChop regulation fighting)
+	- or the stallGuard flag was seen at all.
+
+	stallGuard needs spreadCycle, TCOOLTHRS above the tested speeds and a
+	suitable SGT. Speeds outside of the mapped range are reported as safe.
+*/
+class TMC2130Resonance {
+	public:
+		TMC2130Resonance(TMC2130Stepper &driver);
+		bool map(void (*run)(uint16_t steps_per_s), uint16_t v_min, uint16_t v_max,
+			uint8_t bins=TMC2130_RESONANCE_BINS, uint16_t dwell_ms=200, uint8_t interval_ms=5);
+		void classify(uint8_t drop_percent=25, uint8_t pwm_rise=8);
+		bool safe(uint16_t steps_per_s);
+		uint16_t nearest_safe(uint16_t steps_per_s);
+		uint8_t bands();
+		bool band(uint8_t index, uint16_t &from, uint16_t &to);
+		uint8_t bins();
+		const TMC2130_resonance_bin_t& bin(uint8_t index);
+		uint16_t bin_speed(uint8_t index);
+		void clear();
+
+	private:
+		int16_t bin_of(uint16_t steps_per_s);
+		uint16_t bin_low(uint8_t index);
+		uint16_t bin_high(uint8_t index);
+
+		TMC2130Stepper &drv;
+		TMC2130_resonance_bin_t table[TMC2130_RESONANCE_BINS];
+		uint8_t _bins = 0;
+		uint16_t _v_min = 0, _v_max = 0;
+};
+
+#endif
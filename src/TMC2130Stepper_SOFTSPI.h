@@ -0,0 +1,72 @@
+#ifndef TMC2130Stepper_SOFTSPI_h
+#define TMC2130Stepper_SOFTSPI_h
+
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_FASTIO.h"
+
+#define TMC2130_SOFTSPI_CHANNELS 4
+
+/*
+	Bit-banged SPI mode 3 for drivers that are not on the hardware SPI
+	pins. Each attached driver is a channel with its own chip select and,
+	optionally, its own MOSI and MISO pins. The bus is installed as the
+	driver's bus backend, so all register functions work as usual. The
+	bus has its own arbiter, bus_arbiter(), which attach() gives to the
+	driver. Accesses to the hardware SPI do not wait for it.
+
+	Mode 3: SCK idles high, data is changed on the falling edge and
+	sampled on the rising edge. The 40 bit datagram is shifted out with
+	the bit loop unrolled. On AVR, Cortex-M and ESP8266 interrupts are
+	disabled for the duration of one datagram, which is about 10us on a
+	16MHz AVR, and restored to their previous state afterwards. Elsewhere
+	they stay enabled and may stretch a clock phase.
+
+	read_all() clocks one register out of every channel at the same time.
+	It takes the bus arbiters of all channels' drivers for both datagrams
+	and returns false without a transfer when one of them is busy, or
+	when two channels share a MOSI or MISO pin. As attach() defaults to
+	the constructor's pins, give every channel but one its own pins.
+	All chip selects go low together and each channel's MOSI and MISO line
+	carries its own data. On AVR, MOSI pins sharing a port are set with a
+	single port write per bit.
+
+	TMC2130SoftSPI bus(SCK_PIN, MOSI_PIN, MISO_PIN);
+	bus.attach(driver_x, CS_X);
+	bus.attach(driver_y, CS_Y, MOSI_Y, MISO_Y);
+	uint32_t status[2];
+	bus.read_all(REG_DRV_STATUS, status);
+*/
+class TMC2130SoftSPI {
+	public:
+		TMC2130SoftSPI(uint8_t pinSCK, uint8_t pinMOSI, uint8_t pinMISO);
+		int8_t attach(TMC2130Stepper &driver, uint8_t pinCS, uint8_t pinMOSI=0xFF, uint8_t pinMISO=0xFF);
+		void half_period(uint8_t us);
+		void transfer(uint8_t channel, uint8_t *datagram);
+		void transfer_all(uint8_t (*datagrams)[5]);
+		bool read_all(uint8_t address, uint32_t *values);
+		uint8_t channels();
+		TMC2130Bus& bus_arbiter();
+		static void backend(void *ctx, uint8_t *datagram);
+
+	private:
+		struct channel_t {
+			TMC2130SoftSPI *bus;
+			TMC2130Stepper *driver;
+			TMC2130_fastio::gpio_t cs, mosi, miso;
+		};
+
+		inline uint8_t shift(channel_t &ch, uint8_t out) __attribute__((always_inline));
+		inline void wait() __attribute__((always_inline));
+		TMC2130Bus* arbiter_of(uint8_t channel);
+		void release(uint8_t channels);
+
+		TMC2130_fastio::gpio_t sck;
+		uint8_t default_mosi, default_miso;
+		channel_t ch[TMC2130_SOFTSPI_CHANNELS];
+		uint8_t count = 0;
+		uint8_t _half_period = 0;
+		bool shared = false;	// Two channels on one MOSI or MISO pin
+		TMC2130Bus arbiter;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef TMC2130Stepper_STANDSTILL_h
+#define TMC2130Stepper_STANDSTILL_h
+
+#include "TMC2130Stepper.h"
+
+#ifndef TMC2130_STANDSTILL_MAX_DRIVERS
+	#define TMC2130_STANDSTILL_MAX_DRIVERS 5
+#endif
+
+#define STANDSTILL_MOVING	0	// Run current
+#define STANDSTILL_HOLD		1	// Hold current, reduced by the driver after TPOWERDOWN
+#define STANDSTILL_REDUCED	2	// Hold current lowered further after reduce_ms
+#define STANDSTILL_OFF		3	// Freewheeling or passive braking after off_ms
+
+/*
+	Standstill current policy for a group of drivers.
+
+	The driver itself drops to the hold current TPOWERDOWN after the last
+	step, ramping down over IHOLDDELAY. add() configures both. On top of
+	that the policy lowers the hold current to `reduce_percent` once an
+	axis has been idle for reduce_ms, and switches it off after off_ms
+	using the freewheel mode set with freewheel() (stealthChop only).
+	A zero time disables a stage.
+
+	Call moved() whenever steps are issued and wake() right before a move
+	that follows a long standstill. wake() restores the hold current with
+	at most two writes, so the axis holds position before the first step.
+
+	The energy dissipated in the coils is estimated per axis from the
+	current setting and the coil resistance given to add().
+
+	All functions take the time as an argument (default millis()) so the
+	policy can be run against a simulated clock, see
+	extras/standstill/standstill_test.cpp.
+*/
+class TMC2130Standstill {
+	public:
+		TMC2130Standstill(uint32_t reduce_ms=10000, uint8_t reduce_percent=50, uint32_t off_ms=0);
+		bool add(TMC2130Stepper &driver, float R_coil=0, uint8_t tpowerdown=128, uint8_t iholddelay=6, uint32_t now=millis());
+		void freewheel(uint8_t mode);
+		void update(uint32_t now=millis());
+		void moved(uint8_t i, uint32_t now=millis());
+		void wake(uint8_t i, uint32_t now=millis());
+		uint8_t drivers();
+		uint8_t stage(uint8_t i);
+		uint32_t idle_time(uint8_t i, uint32_t now=millis());
+		float energy(uint8_t i);
+		void clear_energy();
+
+	private:
+		struct axis_t {
+			TMC2130Stepper *driver;
+			float 		R;
+			float 		energy;
+			uint8_t 	ihold_nominal;
+			uint8_t 	stage;
+			uint32_t 	last_move;
+			uint32_t 	last_account;
+			uint32_t 	powerdown_ms;
+		};
+		void account(axis_t &a, uint32_t now);
+		void apply(axis_t &a, uint8_t stage);
+
+		axis_t axes[TMC2130_STANDSTILL_MAX_DRIVERS];
+		uint8_t count = 0;
+		uint32_t _reduce_ms;
+		uint8_t _reduce_percent;
+		uint32_t _off_ms;
+		uint8_t _freewheel = 1;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef TMC2130Stepper_STEALTH_h
+#define TMC2130Stepper_STEALTH_h
+
+#include "TMC2130Stepper.h"
+
+/*
+	stealthChop calibration and PWM_SCALE monitoring for one driver.
+
+	With pwm_autoscale the driver regulates the PWM amplitude by itself,
+	but the regulation needs to settle first at standstill and then in
+	motion. calibrate() runs that sequence and checks that PWM_SCALE
+	settles in both phases.
+
+	update() watches PWM_SCALE while the machine runs. When it stays at
+	`limit` the driver can no longer regulate the current in stealthChop
+	and steps may be lost, so saturated() is set. TSTEP is recorded at
+	each saturation and suggested_threshold() returns a TPWMTHRS that
+	switches to spreadCycle just before that speed.
+*/
+class TMC2130Stealth {
+	public:
+		TMC2130Stealth(TMC2130Stepper &driver, uint8_t limit=255, uint16_t interval=50);
+		bool calibrate(void (*run)(uint16_t steps_per_s), uint16_t speed, uint16_t budget_ms=2000);
+		bool update();
+		bool saturated();
+		uint16_t events();
+		uint8_t peak();
+		uint8_t standstill_scale();
+		uint8_t motion_scale();
+		uint32_t suggested_threshold();
+		void clear();
+
+	private:
+		bool settle(uint8_t &scale, uint32_t start, uint16_t budget_ms);
+
+		TMC2130Stepper &drv;
+		uint8_t _limit;
+		uint16_t _interval;
+		uint32_t last_update = 0;
+		bool _saturated = false;
+		uint8_t hits = 0;
+		uint16_t _events = 0;
+		uint8_t _peak = 0;
+		uint8_t _standstill = 0;
+		uint8_t _motion = 0;
+		uint32_t tstep_saturated = 0;
+};
+
+#endif
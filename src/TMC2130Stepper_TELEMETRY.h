@@ -0,0 +1,68 @@
+#ifndef TMC2130Stepper_TELEMETRY_h
+#define TMC2130Stepper_TELEMETRY_h
+
+#include "TMC2130Stepper.h"
+
+// Fields to record, or'ed together
+#define TELEMETRY_SG_RESULT		0x01
+#define TELEMETRY_CS_ACTUAL		0x02
+#define TELEMETRY_TSTEP			0x04
+#define TELEMETRY_PWM_SCALE		0x08
+#define TELEMETRY_FLAGS			0x10	// DRV_STATUS bits 24..31, fsactive in bit 8
+#define TELEMETRY_FIELDS		5
+
+#define TELEMETRY_MAGIC			0xA7	// First byte of every drained chunk
+
+/*
+	Records driver state at a fixed rate into a ring buffer provided by the
+	sketch. Each record stores the time since the previous record and the
+	change of every selected field as zigzag varints, so a slowly changing
+	value takes one byte. When the buffer is full the oldest records are
+	dropped.
+
+	drain() writes the oldest records as a self-contained chunk:
+
+	MAGIC, fields, varint interval, varint time of the first record,
+	varint records dropped since the last chunk, varint record count,
+	varint absolute value of each field before the first record,
+	records: varint dt, zigzag varint delta of each field
+
+	extras/telemetry_decode.py turns a stream of chunks into CSV.
+*/
+class TMC2130Telemetry {
+	public:
+		TMC2130Telemetry(TMC2130Stepper &driver, uint8_t *buffer, uint16_t size, uint8_t fields=TELEMETRY_SG_RESULT|TELEMETRY_CS_ACTUAL|TELEMETRY_FLAGS, uint16_t interval=10);
+		bool update();
+		void sample();
+		uint16_t drain(Print &out, uint16_t max_bytes=64);
+		uint16_t records();
+		uint16_t used();
+		uint32_t dropped();
+		void clear();
+
+	private:
+		uint8_t encode(uint8_t *rec, uint32_t now, const uint32_t *value);
+		uint8_t next(uint16_t &pos);
+		uint32_t read_varint(uint16_t &pos);
+		uint16_t record_length(uint16_t pos);
+		void consume(Print *out);
+
+		TMC2130Stepper &drv;
+		uint8_t *buf;
+		uint16_t _size;
+		uint8_t _fields;
+		uint16_t _interval;
+		uint16_t head = 0;
+		uint16_t tail = 0;
+		uint16_t _used = 0;
+		uint16_t count = 0;
+		uint32_t _dropped = 0;
+		uint32_t dropped_chunk = 0;
+		uint32_t last_sample = 0;
+		uint32_t last_time = 0;						// Time of the newest record
+		uint32_t last[TELEMETRY_FIELDS] = {};		// Values of the newest record
+		uint32_t base_time = 0;						// Time of the record before the oldest one
+		uint32_t base[TELEMETRY_FIELDS] = {};		// Values before the oldest record
+};
+
+#endif
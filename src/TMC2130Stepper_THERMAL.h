@@ -0,0 +1,52 @@
+#ifndef TMC2130Stepper_THERMAL_h
+#define TMC2130Stepper_THERMAL_h
+
+#include "TMC2130Stepper.h"
+
+#ifndef TMC2130_THERMAL_MAX_DRIVERS
+	#define TMC2130_THERMAL_MAX_DRIVERS 5
+#endif
+
+/*
+	Watches the overtemperature prewarning (OTPW) of a group of drivers and
+	derates the run current instead of letting the driver reach the ot()
+	shutdown. While the warning is active the run current is lowered by
+	`step` every `interval` ms, down to `min_irun`. Once the warning has
+	been clear for `hysteresis` ms the current is raised again one step
+	per interval until the original setting is restored.
+
+	Call update() regularly from loop(). Each call reads DRV_STATUS once
+	per driver.
+*/
+class TMC2130Thermal {
+	public:
+		TMC2130Thermal(uint8_t step=2, uint8_t min_irun=8, uint16_t interval=500, uint16_t hysteresis=5000);
+		bool add(TMC2130Stepper &driver);
+		void update();
+		uint8_t drivers();
+		bool derating(uint8_t i);
+		uint16_t events(uint8_t i);
+		uint32_t derated_time(uint8_t i);
+		uint8_t nominal_irun(uint8_t i);
+
+	private:
+		struct axis_t {
+			TMC2130Stepper *driver;
+			uint8_t 	irun_nominal;
+			uint8_t 	level;
+			bool 		warning;
+			uint16_t 	events;
+			uint32_t 	last_change;
+			uint32_t 	clear_since;
+			uint32_t 	derated_ms;
+		};
+		axis_t axes[TMC2130_THERMAL_MAX_DRIVERS];
+		uint8_t count = 0;
+		uint8_t _step;
+		uint8_t _min_irun;
+		uint16_t _interval;
+		uint16_t _hysteresis;
+		uint32_t last_update = 0;
+};
+
+#endif
@@ -1,4 +1,6 @@
-#include <SPI.h>
+#ifdef ARDUINO
+	#include <SPI.h>
+#endif
 #include "TMC2130Stepper.h"
 #include "TMC2130Stepper_MACROS.h"
 
@@ -53,66 +55,190 @@ void TMC2130Stepper::begin() {
 	toff(8); //off_time(8);
 	tbl(1); //blank_time(24);
 
+	GSTAT(RESET_bm); // Power on reset is expected here, clear it so a later one can be detected
 	_started = true;
 }
 
+/*
+	Routes all datagrams through backend instead of hardware SPI. The
+	backend gets the 5 byte datagram (address byte first) and replaces it
+	with the reply, including the status byte. Chip select is up to the
+	backend. NULL goes back to hardware SPI.
+*/
+void TMC2130Stepper::bus_backend(TMC2130_bus_t backend, void *ctx) {
+	bus = backend;
+	bus_ctx = ctx;
+}
+
+// Call when the chip was accessed by someone else, e.g. TMC2130SoftSPI::read_all().
+// The reply latch no longer belongs to our last datagram, so the next read takes two.
+void TMC2130Stepper::resync() { last_frame = 0xFF; }
+
+// Drivers on another bus than the hardware SPI can use their own arbiter, see TMC2130Bus
+void TMC2130Stepper::bus_arbiter(TMC2130Bus &bus) { arbiter = &bus; }
+TMC2130Bus& TMC2130Stepper::bus_arbiter() { return *arbiter; }
+
+// True when the last register read found the bus taken and returned the
+// shadow value or 0 instead of the register. Check it after reads from an
+// interrupt, e.g. a DRV_STATUS() of 0 then does not mean "no fault".
+bool TMC2130Stepper::read_dropped() { return _read_dropped; }
+
+// One 40 bit datagram. Returns the data part of the reply, which belongs to
+// the read request of the previous datagram.
+uint32_t TMC2130Stepper::transfer2130(uint8_t addressByte, uint32_t data) {
+	uint32_t reply = 0;
+	if (bus) {
+		uint8_t datagram[5] = { addressByte, (uint8_t)(data >> 24), (uint8_t)(data >> 16), (uint8_t)(data >> 8), (uint8_t)data };
+		bus(bus_ctx, datagram);
+		status_response = datagram[0];
+		reply = (uint32_t)datagram[1] << 24 | (uint32_t)datagram[2] << 16 | (uint32_t)datagram[3] << 8 | datagram[4];
+	} else {
+#ifdef ARDUINO
+		SPI.begin();
+		SPI.beginTransaction(SPISettings(16000000/8, MSBFIRST, SPI_MODE3));
+		digitalWrite(_pinCS, LOW);
+
+		status_response = SPI.transfer(addressByte & 0xFF);
+		reply = SPI.transfer((data >> 24) & 0xFF);
+		reply <<= 8;
+		reply |= SPI.transfer((data >> 16) & 0xFF);
+		reply <<= 8;
+		reply |= SPI.transfer((data >>  8) & 0xFF);
+		reply <<= 8;
+		reply |= SPI.transfer(data & 0xFF);
+
+		digitalWrite(_pinCS, HIGH);
+		SPI.endTransaction();
+#else
+		status_response = 0; // No bus without a backend on the host
+#endif
+	}
+	last_frame = addressByte;
+
+	#ifdef TMC2130_SPI_STATS
+		stats.frames++;
+		stats.bytes += 5;
+	#endif
+	return reply;
+}
+
+/*
+	One register access with the bus taken from the arbiter. When the bus
+	is in use, this was called from an interrupt that preempted another
+	access: a write is queued with the value, which is already in the
+	shadow register, and a read leaves *config as it is and sets
+	read_dropped(). A write that
+	does not fit into the queue is made up for by restore() at the next
+	access that gets the bus.
+*/
 //uint32_t TMC2130Stepper::send2130(uint8_t addressByte, uint32_t *config, uint32_t value, uint32_t mask) {
 void TMC2130Stepper::send2130(uint8_t addressByte, uint32_t *config) {
-	//uint8_t s;
-	SPI.begin();
-	SPI.beginTransaction(SPISettings(16000000/8, MSBFIRST, SPI_MODE3));
-	digitalWrite(_pinCS, LOW);
+	bool read = !(addressByte >> 7);
+	if (!arbiter->acquire()) {
+		if (read) {
+			arbiter->dropped();
+			_read_dropped = true;
+		}
+		else if (!arbiter->queue(*this, addressByte, *config, NULL, NULL, 0)) _replay = true;
+		return;
+	}
+	uint32_t shadow = *config;
+	transact(addressByte, config);
+	if (read) _read_dropped = false;
+	arbiter->release();
+
+	if (_replay && !_restoring) {
+		_replay = false;
+		restore();
+	}
 
-	status_response = SPI.transfer(addressByte & 0xFF); // s = 
-	#ifdef TMC2130DEBUG
-		Serial.println("## Received parameters:");
-		Serial.print("## Address byte: ");
-		Serial.println(addressByte, HEX);
-		Serial.print("## Config: ");
-		Serial.println(*config, BIN);
-		Serial.print("## status_response: ");
-		Serial.println(status_response, BIN);
+	// The driver lost its configuration. A read returned the power on
+	// defaults, so keep the shadow, replay everything and read again.
+	if ((status_response & STATUS_RESET_bm) && _started && _auto_restore && !_restoring) {
+		if (read) *config = shadow;
+		recover(addressByte, config);
+	}
+}
+
+// The datagrams of one access, called with the bus taken
+void TMC2130Stepper::transact(uint8_t addressByte, uint32_t *config) {
+	#ifdef TMC2130_SPI_STATS
+		uint32_t t_start = micros();
 	#endif
 
 	if (addressByte >> 7) { // Check if WRITE command
-		//*config &= ~mask; // Clear bits being set
-		//*config |= (value & mask); // Set new values
-		SPI.transfer((*config >> 24) & 0xFF);
-		SPI.transfer((*config >> 16) & 0xFF);
-		SPI.transfer((*config >>  8) & 0xFF);
-		SPI.transfer(*config & 0xFF);
+		transfer2130(addressByte, *config);
 		#ifdef TMC2130DEBUG
 			Serial.println("## WRITE cmd");
-			Serial.println("##########################");
 		#endif
 	} else { // READ command
-		SPI.transfer16(0x0000); // Clear SPI
-		SPI.transfer16(0x0000);
-		digitalWrite(_pinCS, HIGH);
-		digitalWrite(_pinCS, LOW);
-
-		SPI.transfer(addressByte & 0xFF); // Send the address byte again
-		*config  = SPI.transfer(0x00);
-		*config <<= 8;
-		*config |= SPI.transfer(0x00);
-		*config <<= 8;
-		*config |= SPI.transfer(0x00);
-		*config <<= 8;
-		*config |= SPI.transfer(0x00);
+		transfer2130(addressByte, 0); // Request
+		uint8_t status = status_response;
+		*config = transfer2130(addressByte, 0); // Send the address byte again to clock out the reply
+		status_response = status; // Keep the flags from before a read of GSTAT cleared them
 		#ifdef TMC2130DEBUG
 			Serial.println("## READ cmd");
-			Serial.print("## Received config: ");
-			Serial.println(*config, BIN);
-			Serial.println("##########################");
 		#endif
 	}
+	#ifdef TMC2130DEBUG
+		Serial.print("## Address byte: ");
+		Serial.println(addressByte, HEX);
+		Serial.print("## Config: ");
+		Serial.println(*config, BIN);
+		Serial.print("## status_response: ");
+		Serial.println(status_response, BIN);
+		Serial.println("##########################");
+	#endif
 
-	digitalWrite(_pinCS, HIGH);
-	SPI.endTransaction();
+	#ifdef TMC2130_SPI_STATS
+		uint32_t t = micros() - t_start;
+		uint8_t reg = addressByte & 0x7F;
+		uint8_t bin = 0;
+		for (uint32_t limit = 16; t >= limit && bin < TMC2130_STATS_BINS-1; limit <<= 1) bin++;
+		stats.latency[bin]++;
+		if (t > stats.latency_max) stats.latency_max = t;
+		if (reg < TMC2130_STATS_REGS) {
+			if (addressByte >> 7) stats.writes[reg]++;
+			else stats.reads[reg]++;
+		}
+	#endif
+}
 
-	//return s;
+/*
+	Reads a register with a single datagram when the previous datagram
+	already requested it, otherwise falls back to the two datagram read.
+	The value returned is the one latched at the previous access, so this
+	suits registers that are sampled in a loop, like TSTEP.
+*/
+uint32_t TMC2130Stepper::read_pipelined(uint8_t address) {
+	uint32_t value = 0;
+	if (!arbiter->acquire()) {
+		arbiter->dropped();
+		_read_dropped = true;
+		return 0;
+	}
+	if (last_frame != (TMC2130_READ|address)) {
+		arbiter->release();
+		send2130(TMC2130_READ|address, &value);
+		return value;
+	}
+	value = transfer2130(TMC2130_READ|address, 0);
+	_read_dropped = false;
+	arbiter->release();
+	#ifdef TMC2130_SPI_STATS
+		if (address < TMC2130_STATS_REGS) stats.reads[address]++;
+	#endif
+	if ((status_response & STATUS_RESET_bm) && _started && _auto_restore && !_restoring) {
+		recover(TMC2130_READ|address, &value);
+	}
+	return value;
 }
 
+#ifdef TMC2130_SPI_STATS
+const TMC2130_spi_stats_t& TMC2130Stepper::spi_stats() { return stats; }
+void TMC2130Stepper::clear_spi_stats() { memset(&stats, 0, sizeof(stats)); }
+#endif
+
 bool TMC2130Stepper::checkOT() {
 	uint32_t response = DRV_STATUS();
 	if (response & OTPW_bm) {
@@ -135,19 +261,11 @@ void 	TMC2130Stepper::GSTAT(uint8_t input){
 	WRITE_REG(GSTAT);
 }
 uint8_t TMC2130Stepper::GSTAT()			 	{ READ_REG_R(GSTAT); 		}
-bool 	TMC2130Stepper::reset()				{ GET_BYTE(GSTAT, RESET);	}
-bool 	TMC2130Stepper::drv_err()			{ GET_BYTE(GSTAT, DRV_ERR);	}
-bool 	TMC2130Stepper::uv_cp()				{ GET_BYTE(GSTAT, UV_CP);	}
+TMC2130_GSTAT_FIELDS(TMC2130_DEFINE)
 ///////////////////////////////////////////////////////////////////////////////////////
 // R: IOIN
 uint32_t 	TMC2130Stepper::IOIN() 			{ READ_REG_R(IOIN); 				}
-bool 		TMC2130Stepper::step()			{ GET_BYTE_R(IOIN, STEP);			}
-bool 		TMC2130Stepper::dir()			{ GET_BYTE_R(IOIN, DIR);			}
-bool 		TMC2130Stepper::dcen_cfg4()		{ GET_BYTE_R(IOIN, DCEN_CFG4);		}
-bool 		TMC2130Stepper::dcin_cfg5()		{ GET_BYTE_R(IOIN, DCIN_CFG5);		}
-bool 		TMC2130Stepper::drv_enn_cfg6()	{ GET_BYTE_R(IOIN, DRV_ENN_CFG6);	}
-bool 		TMC2130Stepper::dco()			{ GET_BYTE_R(IOIN, DCO);			}
-uint8_t 	TMC2130Stepper::version() 		{ GET_BYTE_R(IOIN, VERSION);		}
+TMC2130_IOIN_FIELDS(TMC2130_DEFINE)
 ///////////////////////////////////////////////////////////////////////////////////////
 // W: TPOWERDOWN
 uint32_t TMC2130Stepper::TPOWERDOWN() { return TPOWERDOWN_sr; }
@@ -186,10 +304,7 @@ void TMC2130Stepper::XDIRECT(uint32_t input) {
 	XDIRECT_sr = input;
 	WRITE_REG(XDIRECT);
 }
-void TMC2130Stepper::coil_A(int16_t B) 	{ MOD_REG(XDIRECT, COIL_A); 	}
-void TMC2130Stepper::coil_B(int16_t B) 	{ MOD_REG(XDIRECT, COIL_B); 	}
-int16_t TMC2130Stepper::coil_A() 		{ GET_BYTE_R(XDIRECT, COIL_A); 	}
-int16_t TMC2130Stepper::coil_B() 		{ GET_BYTE_R(XDIRECT, COIL_A); 	}
+TMC2130_XDIRECT_FIELDS(TMC2130_DEFINE)
 ///////////////////////////////////////////////////////////////////////////////////////
 // W: VDCMIN
 uint32_t TMC2130Stepper::VDCMIN() { return VDCMIN_sr; }
@@ -198,6 +313,9 @@ void TMC2130Stepper::VDCMIN(uint32_t input) {
 	WRITE_REG(VDCMIN);
 }
 ///////////////////////////////////////////////////////////////////////////////////////
+// R: MSCNT
+uint16_t TMC2130Stepper::MSCNT() { READ_REG_R(MSCNT); }
+///////////////////////////////////////////////////////////////////////////////////////
 // R: PWM_SCALE
 uint8_t TMC2130Stepper::PWM_SCALE() { READ_REG_R(PWM_SCALE); }
 ///////////////////////////////////////////////////////////////////////////////////////
@@ -207,10 +325,7 @@ void TMC2130Stepper::ENCM_CTRL(uint8_t input) {
 	ENCM_CTRL_sr = input;
 	WRITE_REG(ENCM_CTRL);
 }
-void TMC2130Stepper::inv(bool B)		{ MOD_REG(ENCM_CTRL, INV);		}
-void TMC2130Stepper::maxspeed(bool B)	{ MOD_REG(ENCM_CTRL, MAXSPEED); }
-bool TMC2130Stepper::inv() 				{ GET_BYTE(ENCM_CTRL, INV); 	}
-bool TMC2130Stepper::maxspeed() 		{ GET_BYTE(ENCM_CTRL, MAXSPEED);}
+TMC2130_ENCM_CTRL_FIELDS(TMC2130_DEFINE)
 ///////////////////////////////////////////////////////////////////////////////////////
 // R: LOST_STEPS
 uint32_t TMC2130Stepper::LOST_STEPS() { READ_REG_R(LOST_STEPS); }
@@ -307,11 +422,17 @@ uint8_t TMC2130Stepper::blank_time() {
 	}
 }
 
-void TMC2130Stepper::hysterisis_low(int8_t value) { hend(value+3); }
-int8_t TMC2130Stepper::hysterisis_low() { return hend()-3; };
+void TMC2130Stepper::hysterisis_low(int8_t value) {
+	CHOPCONF_sr = TMC2130_n::HYSTERESIS_END_v::set(CHOPCONF_sr, value);
+	WRITE_REG(CHOPCONF);
+}
+int8_t TMC2130Stepper::hysterisis_low() { return TMC2130_n::HYSTERESIS_END_v::get(CHOPCONF()); }
 
-void TMC2130Stepper::hysterisis_start(uint8_t value) { hstrt(value-1); }
-uint8_t TMC2130Stepper::hysterisis_start() { return hstrt()+1; }
+void TMC2130Stepper::hysterisis_start(uint8_t value) {
+	CHOPCONF_sr = TMC2130_n::HYSTERESIS_START_v::set(CHOPCONF_sr, value);
+	WRITE_REG(CHOPCONF);
+}
+uint8_t TMC2130Stepper::hysterisis_start() { return TMC2130_n::HYSTERESIS_START_v::get(CHOPCONF()); }
 
 void TMC2130Stepper::sg_current_decrease(uint8_t value) {
 	switch(value) {
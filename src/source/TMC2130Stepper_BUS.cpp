@@ -0,0 +1,175 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+TMC2130Bus TMC2130Bus::spi;
+
+namespace {
+	// One byte atomics. AVR has no exchange instruction, so interrupts are
+	// masked for the few cycles of the read-modify-write instead.
+#if defined(__AVR__)
+	inline uint8_t exchange(volatile uint8_t *v, uint8_t value) {
+		uint8_t sreg = SREG;
+		cli();
+		uint8_t old = *v;
+		*v = value;
+		SREG = sreg;
+		return old;
+	}
+	inline bool compare_exchange(volatile uint8_t *v, uint8_t expected, uint8_t value) {
+		uint8_t sreg = SREG;
+		cli();
+		bool ok = *v == expected;
+		if (ok) *v = value;
+		SREG = sreg;
+		return ok;
+	}
+	inline uint8_t add(volatile uint8_t *v, int8_t n) {
+		uint8_t sreg = SREG;
+		cli();
+		uint8_t old = *v;
+		*v = old + n;
+		SREG = sreg;
+		return old;
+	}
+#else
+	inline uint8_t exchange(volatile uint8_t *v, uint8_t value) {
+		return __atomic_exchange_n(v, value, __ATOMIC_ACQ_REL);
+	}
+	inline bool compare_exchange(volatile uint8_t *v, uint8_t expected, uint8_t value) {
+		return __atomic_compare_exchange_n(v, &expected, value, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+	}
+	inline uint8_t add(volatile uint8_t *v, int8_t n) {
+		return __atomic_fetch_add(v, n, __ATOMIC_ACQ_REL);
+	}
+#endif
+}
+
+// Takes the bus if it is free. Never waits.
+bool TMC2130Bus::acquire() {
+	if (exchange(&_busy, 1)) {
+		_stats.contended++;
+		return false;
+	}
+	return true;
+}
+
+/*
+	Runs the transactions queued in the meantime and frees the bus. An
+	entry queued just before the bus became free is picked up by taking
+	the bus again, so nothing is left behind until the next access.
+*/
+void TMC2130Bus::release() {
+	do {
+		run_queue();
+		exchange(&_busy, 0);
+	} while (_pending && !exchange(&_busy, 1));
+	if (_completed) complete();
+}
+
+bool TMC2130Bus::busy() { return _busy; }
+uint8_t TMC2130Bus::pending() { return _pending; }
+
+/*
+	Reads or writes (address | TMC2130_WRITE) a register of `driver`. When
+	the bus is free the transaction runs right away and `done` is called
+	before returning true. Otherwise it is queued and `done` is called
+	from whichever context releases the bus. Returns false when the queue
+	is full. Writes do not update the driver's shadow registers.
+*/
+bool TMC2130Bus::submit(TMC2130Stepper &driver, uint8_t address, uint32_t data,
+	TMC2130_bus_done_t done, void *ctx, uint8_t priority) {
+	if (!exchange(&_busy, 1)) {
+		driver.transact(address, &data);
+		_stats.transactions++;
+		uint8_t status = driver.status_response;
+		release();
+		if (done) done(ctx, data, status);
+		return true;
+	}
+	_stats.contended++;
+	return queue(driver, address, data, done, ctx, priority);
+}
+
+bool TMC2130Bus::queue(TMC2130Stepper &driver, uint8_t address, uint32_t data,
+	TMC2130_bus_done_t done, void *ctx, uint8_t priority) {
+	// A write nobody waits for replaces a queued write of the same register
+	if ((address & TMC2130_WRITE) && !done) {
+		for (uint8_t i = 0; i < TMC2130_BUS_QUEUE; i++) {
+			entry_t &e = entries[i];
+			if (e.driver != &driver || e.address != address || e.done) continue;
+			if (!compare_exchange(&e.state, PENDING, CLAIMED)) continue;
+			e.data = data;
+			e.state = PENDING;
+			_stats.deferred++;
+			return true;
+		}
+	}
+	for (uint8_t i = 0; i < TMC2130_BUS_QUEUE; i++) {
+		entry_t &e = entries[i];
+		if (!compare_exchange(&e.state, FREE, CLAIMED)) continue;
+		e.driver = &driver;
+		e.address = address;
+		e.data = data;
+		e.done = done;
+		e.ctx = ctx;
+		e.priority = priority;
+		e.seq = add(&seq, 1);
+		e.queued = micros();
+		add(&_pending, 1);
+		e.state = PENDING;
+		_stats.deferred++;
+		return true;
+	}
+	_stats.dropped++;
+	return false;
+}
+
+void TMC2130Bus::dropped() { _stats.dropped++; }
+
+// Highest priority, then oldest
+TMC2130Bus::entry_t* TMC2130Bus::next() {
+	entry_t *best = NULL;
+	for (uint8_t i = 0; i < TMC2130_BUS_QUEUE; i++) {
+		entry_t &e = entries[i];
+		if (e.state != PENDING) continue;
+		if (!best || e.priority > best->priority ||
+			(e.priority == best->priority && (int8_t)(e.seq - best->seq) < 0)) best = &e;
+	}
+	return best;
+}
+
+// Called with the bus taken
+void TMC2130Bus::run_queue() {
+	while (_pending) {
+		entry_t *e = next();
+		if (!e) return;		// Counted but still being filled in by an interrupt we preempted
+		e->state = RUNNING;
+		add(&_pending, -1);
+		e->driver->transact(e->address, &e->data);
+		e->status = e->driver->status_response;
+		_stats.transactions++;
+		uint32_t wait = micros() - e->queued;
+		_stats.wait_total += wait;
+		if (wait > _stats.wait_max) _stats.wait_max = wait;
+		e->state = DONE;
+		add(&_completed, 1);
+	}
+}
+
+// Calls back finished entries, with the bus free
+void TMC2130Bus::complete() {
+	for (uint8_t i = 0; i < TMC2130_BUS_QUEUE && _completed; i++) {
+		entry_t &e = entries[i];
+		if (!compare_exchange(&e.state, DONE, COMPLETING)) continue;
+		add(&_completed, -1);
+		TMC2130_bus_done_t done = e.done;
+		void *ctx = e.ctx;
+		uint32_t data = e.data;
+		uint8_t status = e.status;
+		e.state = FREE;
+		if (done) done(ctx, data, status);
+	}
+}
+
+const TMC2130_bus_stats_t& TMC2130Bus::stats() { return _stats; }
+void TMC2130Bus::clear_stats() { memset(&_stats, 0, sizeof(_stats)); }
@@ -0,0 +1,137 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+#include <math.h>
+
+#define CHOPPER_F_TARGET	30000	// Hz, keeps the chopper above the audible range
+#define CHOPPER_T_BLANK		1.5e-6	// Shortest blank time in s to cover switching ringing
+#define CHOPPER_SETTLE_MS	200		// Wait after a speed change
+#define CHOPPER_SAMPLES		16		// SG_RESULT readings per speed
+#define CHOPPER_SAMPLE_MS	5
+
+/*
+	Starting values for the spreadCycle chopper, following the spreadCycle
+	sheet in extras/TMC5130_TMC2130_TMC2100_Calculations.xlsx:
+
+	t_SD		= (12 + 32*TOFF) / f_clk
+	f_chop		= 1 / (2*t_SD + 2*t_BLANK)
+	dI_blank	= VM * t_BLANK / L
+	dI_sd		= R * I_peak * 2 * t_SD / L
+	hysteresis	= 0.5 + (dI_blank + dI_sd) * 2 * 248 / I_peak - 8
+
+	The blank time is the shortest one above CHOPPER_T_BLANK and TOFF is chosen
+	for a chopper frequency near CHOPPER_F_TARGET. I_peak is the coil current at
+	the run current setting CS. The hysteresis is split into
+	hysterisis_start (up to 8) and hysterisis_low.
+*/
+static int8_t chopper_hysteresis(const TMC2130_motor_t &motor, float I_peak, uint8_t toff, uint8_t tbl_clk, uint32_t fclk) {
+	float t_sd = (12 + 32*toff) / (float)fclk;
+	float t_blank = tbl_clk / (float)fclk;
+	float L = motor.L / 1000.0;
+	float dI = motor.VM * t_blank / L + motor.R * I_peak * 2 * t_sd / L;
+	float hyst = floor(0.5 + dI * 2 * 248 / I_peak - 8);
+	return constrain(hyst, -2, 16);
+}
+
+static void chopper_split(int8_t hyst, uint8_t &hstart, int8_t &hlow) {
+	hstart = constrain(hyst, 1, 8);
+	hlow = constrain(hyst - hstart, -3, 12);
+}
+
+/*
+	Computes chopper settings from the motor data and the current run current
+	and writes them to CHOPCONF.
+
+	When run() and a list of speeds are given, the settings are refined with
+	the motor moving: TOFF and the hysteresis are varied by one step around the
+	starting values, run() is called with every speed and the variance of
+	SG_RESULT is measured. The combination with the least StallGuard noise is
+	kept, ties go to the starting values. stealthChop is turned off during the measurement and run(0) is called
+	at the end. Refining takes about 2.5s per speed. Returns false if the motor data is invalid or the driver
+	reported a fault while running. CHOPCONF is then set back to the value it had
+	before the call.
+*/
+bool TMC2130Stepper::tuneChopper(const TMC2130_motor_t &motor, TMC2130_chopper_t &result,
+		void (*run)(uint16_t steps_per_s), const uint16_t *speeds, uint8_t count) {
+	memset(&result, 0, sizeof(result));
+	if (motor.L <= 0 || motor.R <= 0 || motor.VM <= 0 || !fclk) return false;
+	uint32_t chopconf = CHOPCONF_sr;
+
+	uint8_t tbl_setting = 3;
+	for (uint8_t t = 0; t < 4; t++) {
+		uint8_t clk = t == 0 ? 16 : t == 1 ? 24 : t == 2 ? 36 : 54;
+		if (clk >= CHOPPER_T_BLANK * fclk) { tbl_setting = t; break; }
+	}
+	tbl(tbl_setting);
+	uint8_t tbl_clk = blank_time();
+
+	float t_sd = 0.5 / CHOPPER_F_TARGET - tbl_clk / (float)fclk;
+	uint8_t off = constrain(round((t_sd * fclk - 12) / 32), 2, 15);
+
+	uint8_t cs = irun();
+	float I_peak = (cs+1) / 32.0 * (vsense() ? 0.180 : 0.325) / (Rsense + 0.02);
+	int8_t hyst = chopper_hysteresis(motor, I_peak, off, tbl_clk, fclk);
+
+	chm(0);
+	uint8_t best_off = off;
+	int8_t best_hyst = hyst;
+	uint16_t best_noise = 0;
+
+	if (run && speeds && count) {
+		uint32_t gconf = GCONF_sr;
+		en_pwm_mode(false);
+		bool fault = false;
+		uint32_t least = 0xFFFFFFFFUL;
+		for (int8_t d_off = -1; d_off <= 1 && !fault; d_off++) {
+			for (int8_t d_hyst = -1; d_hyst <= 1 && !fault; d_hyst++) {
+				uint8_t o = constrain(off + d_off, 2, 15);
+				int8_t h = constrain(hyst + d_hyst, -2, 16);
+				uint8_t hstart;
+				int8_t hlow;
+				chopper_split(h, hstart, hlow);
+				toff(o);
+				hysterisis_start(hstart);
+				hysterisis_low(hlow);
+
+				uint32_t noise = 0;
+				for (uint8_t i = 0; i < count && !fault; i++) {
+					run(speeds[i]);
+					delay(CHOPPER_SETTLE_MS);
+					uint32_t sum = 0, sum_sq = 0;
+					for (uint8_t n = 0; n < CHOPPER_SAMPLES; n++) {
+						uint32_t drv_status = DRV_STATUS();
+						if (drv_status & (OT_bm|S2GA_bm|S2GB_bm)) { fault = true; break; }
+						uint16_t sg = (drv_status & SG_RESULT_bm) >> SG_RESULT_bp;
+						sum += sg;
+						sum_sq += (uint32_t)sg*sg;
+						delay(CHOPPER_SAMPLE_MS);
+					}
+					noise += (sum_sq - sum*sum/CHOPPER_SAMPLES) / CHOPPER_SAMPLES;
+				}
+				if (!fault && (noise < least || (noise == least && !d_off && !d_hyst))) {
+					least = noise;
+					best_off = o;
+					best_hyst = h;
+				}
+			}
+		}
+		run(0);
+		GCONF(gconf);
+		if (fault) {
+			CHOPCONF(chopconf);
+			return false;
+		}
+		best_noise = min(least / count, 0xFFFFUL);
+		result.refined = true;
+	}
+
+	chopper_split(best_hyst, result.hysterisis_start, result.hysterisis_low);
+	toff(best_off);
+	hysterisis_start(result.hysterisis_start);
+	hysterisis_low(result.hysterisis_low);
+
+	result.toff = best_off;
+	result.blank_time = tbl_clk;
+	result.f_chop = fclk / (2*(12 + 32*best_off) + 2*tbl_clk);
+	result.noise = best_noise;
+	return true;
+}
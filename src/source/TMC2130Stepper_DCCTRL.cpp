@@ -0,0 +1,93 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+#define PIN_NC	0xFF
+
+// DCCTRL
+uint32_t TMC2130Stepper::DCCTRL() { return DCCTRL_sr; }
+void TMC2130Stepper::DCCTRL(uint32_t input) {
+	DCCTRL_sr = input;
+	WRITE_REG(DCCTRL);
+}
+
+TMC2130_DCCTRL_FIELDS(TMC2130_DEFINE)
+
+/*
+	dcStep is used above the velocity set by VDCMIN, in units of
+	1/256 microsteps per t = 2^24/f_clk:
+
+	VDCMIN = steps/s * 256/mres * 2^24 / f_clk
+*/
+void TMC2130Stepper::dcstep_speed(uint32_t steps_per_s) {
+	uint16_t ms = 256 >> TMC2130_n::MRES_f::get(CHOPCONF_sr);
+	float vdcmin = (float)steps_per_s * (256 / ms) * 16777216.0 / fclk;
+	VDCMIN(vdcmin > VDCMIN_bm ? VDCMIN_bm : (uint32_t)vdcmin);
+}
+
+uint32_t TMC2130Stepper::dcstep_speed() {
+	uint16_t ms = 256 >> TMC2130_n::MRES_f::get(CHOPCONF_sr);
+	return (float)VDCMIN_sr * fclk / 16777216.0 / (256 / ms) + 0.5;
+}
+
+/*
+	DCCTRL starting values from the blank time:
+	DC_TIME slightly above the blank time in clock cycles,
+	DC_SG slightly above DC_TIME/16.
+*/
+void TMC2130Stepper::dcstep_auto() {
+	uint16_t time = blank_time() + blank_time()/8 + 1;
+	DCCTRL_sr = TMC2130_n::DC_TIME_f::set(DCCTRL_sr, time);
+	DCCTRL_sr = TMC2130_n::DC_SG_f::set(DCCTRL_sr, time/16 + 1);
+	WRITE_REG(DCCTRL);
+}
+
+/*
+	dcStep is switched on with the DCEN pin of the driver and the driver
+	signals with DCO that the step generator has to wait before the next
+	step. Pass 0xFF for pins that are not connected.
+*/
+void TMC2130Stepper::dcstep_pins(uint8_t pinDCEN, uint8_t pinDCO) {
+	_pinDCEN = pinDCEN;
+	_pinDCO = pinDCO;
+	if (_pinDCEN != PIN_NC) {
+		pinMode(_pinDCEN, OUTPUT);
+		digitalWrite(_pinDCEN, LOW);
+	}
+	if (_pinDCO != PIN_NC) pinMode(_pinDCO, INPUT);
+}
+
+void TMC2130Stepper::dcstep_enable(bool enable) {
+	if (_pinDCEN != PIN_NC) digitalWrite(_pinDCEN, enable);
+}
+
+/*
+	True while the driver asks the step generator to hold the next step.
+	Reads the DCO pin if connected, otherwise IOIN over SPI. Repeated
+	calls without the pin take one datagram each.
+*/
+bool TMC2130Stepper::dcstep_wait() {
+	if (_pinDCO != PIN_NC) return digitalRead(_pinDCO);
+	return read_pipelined(REG_IOIN) & DCO_bm;
+}
+
+/*
+	Waits up to timeout_us for DCO to release. Returns false on timeout:
+	the motor could not follow even at VDCMIN, which is counted as a stall
+	so the caller can stop and re-home instead of losing steps.
+	Steps that had to wait are counted in dcstep_waits().
+*/
+bool TMC2130Stepper::dcstep_ready(uint16_t timeout_us) {
+	if (!dcstep_wait()) return true;
+	dco_waits++;
+	uint32_t start = micros();
+	while (dcstep_wait()) {
+		if (micros() - start >= timeout_us) {
+			dco_stalls++;
+			return false;
+		}
+	}
+	return true;
+}
+
+uint32_t TMC2130Stepper::dcstep_waits() { return dco_waits; }
+uint16_t TMC2130Stepper::dcstep_stalls() { return dco_stalls; }
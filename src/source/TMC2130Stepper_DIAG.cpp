@@ -0,0 +1,172 @@
+#include "TMC2130Stepper_DIAG.h"
+#include "TMC2130Stepper_MACROS.h"
+
+#define PIN_NC 0xFF
+#ifndef NOT_AN_INTERRUPT
+	#define NOT_AN_INTERRUPT -1
+#endif
+
+TMC2130Diag::slot_t TMC2130Diag::slots[TMC2130_DIAG_SLOTS];
+
+// attachInterrupt() takes no context, so every slot has its own entry point
+template<uint8_t N> void TMC2130Diag::isr() { slots[N].diag->fire(slots[N].line); }
+void (* const TMC2130Diag::isrs[TMC2130_DIAG_SLOTS])() = { isr<0>, isr<1>, isr<2>, isr<3> };
+
+TMC2130Diag::TMC2130Diag(TMC2130Stepper &driver, uint8_t pinDIAG0, uint8_t pinDIAG1) : drv(driver) {
+	pin[0] = pinDIAG0;
+	pin[1] = pinDIAG1;
+}
+
+/*
+	Routes the events to the DIAG pins in GCONF and starts watching them.
+	Returns false when an event is not available on the requested pin or
+	the pin is not connected.
+*/
+bool TMC2130Diag::begin(uint8_t diag0_events, uint8_t diag1_events, bool pushpull) {
+	if (diag0_events & ~(DIAG_EVENT_ERROR|DIAG_EVENT_OTPW|DIAG_EVENT_STALL)) return false;
+	if (diag1_events & ~(DIAG_EVENT_STALL|DIAG_EVENT_INDEX)) return false;
+	if ((diag0_events && pin[0] == PIN_NC) || (diag1_events && pin[1] == PIN_NC)) return false;
+	end();
+
+	drv.diag0_error(diag0_events & DIAG_EVENT_ERROR);
+	drv.diag0_otpw(diag0_events & DIAG_EVENT_OTPW);
+	drv.diag0_stall(diag0_events & DIAG_EVENT_STALL);
+	drv.diag1_stall(diag1_events & DIAG_EVENT_STALL);
+	drv.diag1_index(diag1_events & DIAG_EVENT_INDEX);
+	drv.diag1_onstate(false);
+	drv.diag1_steps_skipped(false);
+	drv.diag0_int_pushpull(pushpull);
+	drv.diag1_pushpull(pushpull);
+
+	routed[0] = diag0_events;
+	routed[1] = diag1_events;
+	_pushpull = pushpull;
+	lines = 0;
+	index_pending = 0;
+	attach(0);
+	attach(1);
+	return true;
+}
+
+// Detaches the interrupts. The GCONF routing is left as it is.
+void TMC2130Diag::end() {
+	for (uint8_t line = 0; line < 2; line++) {
+		if (slot[line] >= 0) {
+			detachInterrupt(digitalPinToInterrupt(pin[line]));
+			slots[slot[line]].diag = NULL;
+			slot[line] = -1;
+		}
+		routed[line] = 0;
+	}
+}
+
+bool TMC2130Diag::attach(uint8_t line) {
+	if (!routed[line]) return false;
+	pinMode(pin[line], _pushpull ? INPUT : INPUT_PULLUP);
+	last_level[line] = digitalRead(pin[line]);
+
+	int irq = digitalPinToInterrupt(pin[line]);
+	if (irq == NOT_AN_INTERRUPT) return false;
+	for (uint8_t i = 0; i < TMC2130_DIAG_SLOTS; i++) {
+		if (slots[i].diag) continue;
+		slots[i].diag = this;
+		slots[i].line = line;
+		slot[line] = i;
+		attachInterrupt(irq, isrs[i], _pushpull ? RISING : FALLING);
+		return true;
+	}
+	return false;	// Out of slots, polled
+}
+
+// Interrupt context: no bus access here, the driver may be in the middle of a datagram
+void TMC2130Diag::fire(uint8_t line) {
+	if (line == 1 && routed[1] == DIAG_EVENT_INDEX) index_pending++;
+	else lines |= 1 << line;
+}
+
+bool TMC2130Diag::active(uint8_t line) {
+	return digitalRead(pin[line]) == (_pushpull ? HIGH : LOW);
+}
+
+bool TMC2130Diag::on(uint8_t events, TMC2130_diag_handler_t handler) {
+	if (handler_count >= TMC2130_DIAG_HANDLERS) return false;
+	handlers[handler_count].events = events;
+	handlers[handler_count].fn = handler;
+	handler_count++;
+	return true;
+}
+
+bool TMC2130Diag::pending() { return lines || index_pending; }
+
+/*
+	Delivers the events that fired since the last call and returns them.
+	DRV_STATUS is read once when DIAG0 or a DIAG1 stall fired, never for
+	index pulses alone. A pin that only carries one event needs no flag
+	to confirm it, so short stalls that are already over are not lost.
+	When nothing is flagged for a pin with several events, all of them
+	are reported, as any of them may have fired. DIAG1 with stall and
+	index reports an index, which fires every electrical period.
+*/
+uint8_t TMC2130Diag::dispatch() {
+	for (uint8_t line = 0; line < 2; line++) {
+		if (!routed[line] || slot[line] >= 0) continue;
+		uint8_t level = digitalRead(pin[line]);
+		if (level != last_level[line] && active(line)) fire(line);
+		last_level[line] = level;
+	}
+
+	noInterrupts();
+	uint8_t l = lines;
+	uint16_t idx = index_pending;
+	lines = 0;
+	index_pending = 0;
+	interrupts();
+
+	uint8_t events = 0;
+	uint32_t drv_status = 0;
+	if (l) {
+		drv_status = drv.DRV_STATUS();
+		_status_reads++;
+		uint8_t flagged = 0;
+		if (drv_status & STALLGUARD_bm) 				flagged |= DIAG_EVENT_STALL;
+		if (drv_status & (OT_bm|S2GA_bm|S2GB_bm)) 	flagged |= DIAG_EVENT_ERROR;
+		if (drv_status & OTPW_bm) 					flagged |= DIAG_EVENT_OTPW;
+		for (uint8_t line = 0; line < 2; line++) {
+			if (!(l & (1 << line))) continue;
+			uint8_t r = routed[line];
+			uint8_t e = flagged & r;
+			// Nothing flagged: report what the pin carries, DIAG1 stall+index falls back to index
+			if (!e) e = (r & DIAG_EVENT_INDEX) ? DIAG_EVENT_INDEX : r;
+			if (e & DIAG_EVENT_INDEX) {
+				e &= ~DIAG_EVENT_INDEX;
+				if (!e) idx++;
+			}
+			events |= e;
+		}
+	}
+	if (idx) {
+		events |= DIAG_EVENT_INDEX;
+		_index_pulses += idx;
+	}
+	if (!events) return 0;
+
+	for (uint8_t i = 0; i < 4; i++) {
+		if ((events & (1 << i)) && counts[i] < 0xFFFF) counts[i]++;
+	}
+	for (uint8_t i = 0; i < handler_count; i++) {
+		uint8_t e = handlers[i].events & events;
+		if (e) handlers[i].fn(e, drv_status);
+	}
+	return events;
+}
+
+// Dispatches that included the event
+uint16_t TMC2130Diag::count(uint8_t event) {
+	for (uint8_t i = 0; i < 4; i++) {
+		if (event == (1 << i)) return counts[i];
+	}
+	return 0;
+}
+
+uint32_t TMC2130Diag::index_pulses() { return _index_pulses; }
+uint32_t TMC2130Diag::status_reads() { return _status_reads; }
@@ -0,0 +1,76 @@
+#include "TMC2130Stepper_FAULT.h"
+#include "TMC2130Stepper_MACROS.h"
+
+// Registers saved with a fault
+static const uint8_t config_regs[TMC2130_FAULT_CONFIG] PROGMEM = {
+	REG_GCONF, REG_IHOLD_IRUN, REG_TPOWERDOWN, REG_TPWMTHRS, REG_TCOOLTHRS,
+	REG_THIGH, REG_CHOPCONF, REG_COOLCONF, REG_PWMCONF
+};
+
+TMC2130FaultRecorder::TMC2130FaultRecorder(TMC2130Stepper &driver, uint8_t trigger, uint8_t post) : drv(driver) {
+	_trigger = trigger;
+	_post = post < TMC2130_FAULT_HISTORY ? post : TMC2130_FAULT_HISTORY-1;
+}
+
+void TMC2130FaultRecorder::sample() { record(drv.DRV_STATUS(), millis()); }
+
+void TMC2130FaultRecorder::record(uint32_t drv_status, uint32_t now) {
+	if (_frozen) return;
+
+	TMC2130_status_t &e = history[head];
+	e.time = now;
+	e.sg_result = (drv_status & SG_RESULT_bm) >> SG_RESULT_bp;
+	e.cs_actual = (drv_status & CS_ACTUAL_bm) >> CS_ACTUAL_bp;
+	e.flags = drv_status >> 24; // stallGuard, ot, otpw, s2ga, s2gb, ola, olb, stst
+	if (++head == TMC2130_FAULT_HISTORY) head = 0;
+	if (count < TMC2130_FAULT_HISTORY) count++;
+
+	if (triggered) {
+		if (!--remaining) _frozen = true;
+	} else if (e.flags & _trigger) {
+		triggered = true;
+		_cause = e.flags & _trigger;
+		_trigger_time = now;
+		for (uint8_t i = 0; i < TMC2130_FAULT_CONFIG; i++)
+			snapshot[i] = drv.shadow(pgm_read_byte(&config_regs[i]));
+		remaining = _post;
+		if (!remaining) _frozen = true;
+	}
+}
+
+void TMC2130FaultRecorder::trigger(uint8_t mask) { _trigger = mask; }
+bool TMC2130FaultRecorder::frozen() { return _frozen; }
+
+// record() may run in an interrupt, it must not see a half cleared recorder
+void TMC2130FaultRecorder::rearm() {
+#if defined(ARDUINO_ARCH_AVR)
+	uint8_t sreg = SREG;
+	cli();
+#else
+	noInterrupts();
+#endif
+	triggered = false;
+	count = 0;
+	_cause = 0;
+	_frozen = false;
+#if defined(ARDUINO_ARCH_AVR)
+	SREG = sreg;
+#else
+	interrupts();
+#endif
+}
+
+uint8_t TMC2130FaultRecorder::entries() { return count; }
+
+// Oldest first. An empty entry for i >= entries().
+const TMC2130_status_t& TMC2130FaultRecorder::entry(uint8_t i) {
+	static const TMC2130_status_t none = {};
+	if (i >= count) return none;
+	uint8_t start = (head + TMC2130_FAULT_HISTORY - count) % TMC2130_FAULT_HISTORY;
+	return history[(start + i) % TMC2130_FAULT_HISTORY];
+}
+
+uint32_t TMC2130FaultRecorder::trigger_time() { return _trigger_time; }
+uint8_t TMC2130FaultRecorder::cause() { return _cause; }
+uint8_t TMC2130FaultRecorder::config_address(uint8_t i) { return i < TMC2130_FAULT_CONFIG ? pgm_read_byte(&config_regs[i]) : 0; }
+uint32_t TMC2130FaultRecorder::config(uint8_t i) { return i < TMC2130_FAULT_CONFIG ? snapshot[i] : 0; }
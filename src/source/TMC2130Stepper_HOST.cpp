@@ -0,0 +1,5 @@
+#include "TMC2130Stepper.h"
+
+#ifndef ARDUINO
+HostSerial Serial;
+#endif
@@ -2,21 +2,34 @@
 #define TMC2130Stepper_MACROS_H
 #include "TMC2130Stepper.h"
 #include "../TMC2130Stepper_REGDEFS.h"
+#include "../TMC2130Stepper_REGMAP.h"
 
-#define WRITE_REG(R) 	send2130(TMC2130_WRITE|REG_##R, &R##_sr);
+// Register and field access generated from the descriptors in TMC2130Stepper_REGMAP.h
 
-#define READ_REG(R)   	send2130(TMC2130_READ|REG_##R, &R##_sr); return R##_sr
+#define WRITE_REG(R) 	static_assert(TMC2130_n::R##_r::writable, #R " is read only"); \
+						send2130(TMC2130_WRITE|TMC2130_n::R##_r::address, &R##_sr);
 
-#define READ_REG_R(R)   tmp_sr=0; send2130(TMC2130_READ|REG_##R, &tmp_sr); return tmp_sr;
+#define READ_REG(R)   	static_assert(TMC2130_n::R##_r::readable, #R " is write only"); \
+						send2130(TMC2130_READ|TMC2130_n::R##_r::address, &R##_sr); return R##_sr
 
-#define MOD_REG(REG, SETTING) 	REG##_sr &= ~SETTING##_bm; \
-								REG##_sr |= ((uint32_t)B<<SETTING##_bp)&SETTING##_bm; \
-								WRITE_REG(REG);
-
-#define GET_BYTE(REG, SETTING) 	return (REG()&SETTING##_bm) >> SETTING##_bp;
+#define READ_REG_R(R)   static_assert(TMC2130_n::R##_r::readable, #R " is write only"); \
+						uint32_t data = 0; send2130(TMC2130_READ|TMC2130_n::R##_r::address, &data); return data;
 
-#define GET_BYTE_R(REG, SETTING) return (REG()&SETTING##_bm) >> SETTING##_bp;
+#define MOD_REG(REG, SETTING) 	static_assert(TMC2130_n::SETTING##_f::reg::address == TMC2130_n::REG##_r::address, #SETTING " is not in " #REG); \
+								REG##_sr = TMC2130_n::SETTING##_f::set(REG##_sr, B); \
+								WRITE_REG(REG);
 
-#define GET_BIT(REG, SETTING) 	return (bool)((REG()&SETTING##_bm) >> SETTING##_bp);
+// Field accessor definitions from the field table, one register per source file
+#define TMC2130_DEFINE_RW(REG, FIELD, NAME) \
+	void TMC2130Stepper::NAME(TMC2130_n::FIELD##_f::type B) { MOD_REG(REG, FIELD); } \
+	TMC2130_n::FIELD##_f::type TMC2130Stepper::NAME() 		{ GET_BYTE(REG, FIELD); }
+#define TMC2130_DEFINE_R(REG, FIELD, NAME) \
+	TMC2130_n::FIELD##_f::type TMC2130Stepper::NAME() 		{ GET_BYTE(REG, FIELD); }
+#define TMC2130_DEFINE_X(REG, FIELD, NAME)
+#define TMC2130_DEFINE_ALIAS(REG, FIELD, NAME)
+#define TMC2130_DEFINE(KIND, REG, FIELD, NAME, ...) 	TMC2130_DEFINE_##KIND(REG, FIELD, NAME)
+
+#define GET_BYTE(REG, SETTING) 	static_assert(TMC2130_n::SETTING##_f::reg::address == TMC2130_n::REG##_r::address, #SETTING " is not in " #REG); \
+								return TMC2130_n::SETTING##_f::get(REG());
 
 #endif
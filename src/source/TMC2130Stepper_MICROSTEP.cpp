@@ -0,0 +1,119 @@
+#include "TMC2130Stepper_MICROSTEP.h"
+#include "TMC2130Stepper_MACROS.h"
+
+#define MRES_FULLSTEP	8
+
+namespace {
+	// MRES for 256..2 microsteps, 0 or 1 for fullstep. 0xFF when not a power of two.
+	uint8_t to_mres(uint16_t microsteps) {
+		if (microsteps <= 1) return MRES_FULLSTEP;
+		for (uint8_t mres = 0; mres < MRES_FULLSTEP; mres++) {
+			if (microsteps == (256 >> mres)) return mres;
+		}
+		return 0xFF;
+	}
+
+	// MSCNT moves by 1 << mres per pulse. Fullsteps sit at the 45 degree positions.
+	inline bool on_grid(uint16_t mscnt, uint8_t mres) {
+		uint16_t grid = 1 << mres;
+		return (mscnt & (grid - 1)) == (mres == MRES_FULLSTEP ? 128 : 0);
+	}
+}
+
+TMC2130Microstep::TMC2130Microstep(TMC2130Stepper &driver) : drv(driver) {
+	levels[0].speed = 0;
+	levels[0].mres = 0;
+}
+
+// Thresholds go from slow to fast, each with a coarser resolution than the one before
+bool TMC2130Microstep::add(uint16_t fullsteps_per_s, uint16_t microsteps) {
+	uint8_t mres = to_mres(microsteps);
+	if (count >= TMC2130_MICROSTEP_LEVELS || mres == 0xFF) return false;
+	if (count && (fullsteps_per_s <= levels[count].speed || mres <= levels[count].mres)) return false;
+	count++;
+	levels[count].speed = fullsteps_per_s;
+	levels[count].mres = mres;
+	return true;
+}
+
+void TMC2130Microstep::hysteresis(uint8_t percent) { _hysteresis = min(percent, (uint8_t)99); }
+
+/*
+	Takes the resolution the driver is set to as the base. With
+	`interpolate` the chip smooths the coarser resolutions to 256
+	microsteps. Returns false when the base is not finer than all levels.
+*/
+bool TMC2130Microstep::begin(bool interpolate) {
+	levels[0].mres = drv.mres();
+	if (count && levels[1].mres <= levels[0].mres) return false;
+	drv.intpol(interpolate);
+	target = current = 0;
+	phase = IDLE;
+	return true;
+}
+
+// Call from loop() with the current or commanded speed
+void TMC2130Microstep::update(uint16_t fullsteps_per_s) {
+	uint8_t level = target;
+	while (level < count && fullsteps_per_s >= levels[level+1].speed) level++;
+	while (level && (uint32_t)fullsteps_per_s * 100 < (uint32_t)levels[level].speed * (100 - _hysteresis)) level--;
+	target = level;
+}
+
+// Call after each STEP pulse. Returns the new divider on the pulse that switched, else 0.
+uint16_t TMC2130Microstep::step() {
+	uint8_t level = target;
+	uint8_t from = levels[current].mres;
+	if (phase == TRACK) mscnt = (mscnt + dir * (1 << from)) & MSCNT_bm;
+	if (level == current) {
+		phase = IDLE;
+		return 0;
+	}
+	uint8_t to = levels[level].mres;
+	bool busy = drv.bus_arbiter().busy();
+	if (to < from) return busy ? 0 : switch_to(level);	// A finer grid contains the current one
+
+	if (phase != TRACK) {
+		if (busy) {
+			phase = IDLE;	// The pulse goes uncounted, start over
+			return 0;
+		}
+		uint16_t m = drv.MSCNT();
+		if (phase == PROBE) {
+			uint16_t moved = (m - mscnt) & MSCNT_bm;
+			if (moved == (1 << from)) 					{ dir =  1; phase = TRACK; }
+			else if (moved == 0x400 - (1 << from)) 		{ dir = -1; phase = TRACK; }
+		} else phase = PROBE;
+		mscnt = m;
+		// Off the current grid, e.g. after MRES was changed elsewhere: no pulse will ever align
+		if (!on_grid(mscnt, from)) return switch_to(level);
+	}
+	if (busy || !on_grid(mscnt, to)) return 0;	// Try the next aligned pulse
+	return switch_to(level);
+}
+
+uint16_t TMC2130Microstep::switch_to(uint8_t level) {
+	drv.mres(levels[level].mres);
+	current = level;
+	phase = IDLE;
+	_switches++;
+	return divider();
+}
+
+/*
+	Lets the chip itself switch to fullstep above `fullsteps_per_s`, with
+	THIGH, vhighfs and optionally vhighchm for the constant off time
+	chopper. This only changes the coil currents, the STEP input keeps its
+	resolution. Set it after begin(), THIGH is calculated for the current
+	resolution.
+*/
+void TMC2130Microstep::fullstep_above(uint16_t fullsteps_per_s, bool constant_off_time) {
+	drv.THIGH(drv.speed_to_tstep((uint32_t)fullsteps_per_s * microsteps()));
+	drv.vhighfs(true);
+	drv.vhighchm(constant_off_time);
+}
+
+uint16_t TMC2130Microstep::microsteps() { return 256 >> levels[current].mres; }
+uint16_t TMC2130Microstep::divider() 	{ return 1 << (levels[current].mres - levels[0].mres); }
+bool TMC2130Microstep::pending() 		{ return target != current; }
+uint32_t TMC2130Microstep::switches() 	{ return _switches; }
@@ -0,0 +1,235 @@
+#include "TMC2130Stepper_PROTOCOL.h"
+
+/*
+	Parameter table. The position of an entry is its binary id,
+	so new parameters may only be appended.
+
+	RW(name)	set through name(value), read through name()
+	RO(name)	read only
+*/
+#define TMC2130_PARAMS(RW, RO) \
+	RW(external_ref)		RW(internal_sense_R)	RW(stealthChop)			RW(commutation) \
+	RW(shaft_dir)			RW(diag0_errors)		RW(diag0_temp_prewarn)	RW(diag0_stall) \
+	RW(diag1_stall)			RW(diag1_index)			RW(diag1_chopper_on)	RW(diag1_steps_skipped) \
+	RW(diag0_active_high)	RW(diag1_active_high)	RW(small_hysterisis)	RW(stop_enable) \
+	RW(direct_mode)			RW(hold_current)		RW(run_current)			RW(hold_delay) \
+	RW(power_down_delay)	RO(microstep_time)		RW(stealth_max_speed)	RW(coolstep_min_speed) \
+	RW(mode_sw_speed)		RW(coil_A_current)		RW(coil_B_current)		RW(DCstep_min_speed) \
+	RW(off_time)			RW(hysterisis_start)	RW(fast_decay_time)		RW(hysterisis_low) \
+	RW(disable_I_comparator) RW(random_off_time)	RW(chopper_mode)		RW(blank_time) \
+	RW(high_sense_R)		RW(fullstep_threshold)	RW(high_speed_mode)		RW(sync_phases) \
+	RW(microsteps)			RW(interpolate)			RW(double_edge_step)	RW(disable_short_protection) \
+	RW(sg_min)				RW(sg_max)				RW(sg_step_width)		RW(sg_current_decrease) \
+	RW(smart_min_current)	RW(sg_stall_value)		RW(sg_filter)			RW(stealth_amplitude) \
+	RW(stealth_gradient)	RW(stealth_freq)		RW(stealth_autoscale)	RW(stealth_symmetric) \
+	RW(standstill_mode)		RW(invert_encoder)		RW(maxspeed)			RW(GCONF) \
+	RW(CHOPCONF)			RW(COOLCONF)			RW(PWMCONF)				RW(IHOLD_IRUN) \
+	RO(DRVSTATUS)			RO(PWM_SCALE)			RO(LOST_STEPS)			RO(IOIN) \
+	RO(sg_result)			RO(cs_actual)			RO(rms_current)
+
+namespace {
+	typedef void (*setter_t)(TMC2130Stepper &d, int32_t value);
+	typedef int32_t (*getter_t)(TMC2130Stepper &d);
+
+	struct param_t {
+		const char *name;
+		setter_t set;
+		getter_t get;
+	};
+
+	#define NAME(N)		const char name_##N[] PROGMEM = #N;
+	#define SETTER(N) 	void set_##N(TMC2130Stepper &d, int32_t v) { d.N(v); }
+	#define GETTER(N) 	int32_t get_##N(TMC2130Stepper &d) { return d.N(); }
+	#define NOP(N)
+	TMC2130_PARAMS(NAME, NAME)
+	TMC2130_PARAMS(SETTER, NOP)
+	TMC2130_PARAMS(GETTER, GETTER)
+	#undef NAME
+	#undef SETTER
+	#undef GETTER
+	#undef NOP
+
+	#define ENTRY_RW(N)	{ name_##N, set_##N, get_##N },
+	#define ENTRY_RO(N)	{ name_##N, NULL, get_##N },
+	const param_t table[] PROGMEM = { TMC2130_PARAMS(ENTRY_RW, ENTRY_RO) };
+	#undef ENTRY_RW
+	#undef ENTRY_RO
+
+	const uint8_t table_size = sizeof(table)/sizeof(table[0]);
+
+	param_t entry(uint8_t id) {
+		param_t p;
+		memcpy_P(&p, &table[id], sizeof(p));
+		return p;
+	}
+
+	void reply_text(Print &out, const char *name, int32_t value) {
+		out.print(name);
+		out.print(' ');
+		out.println((long)value);
+	}
+}
+
+TMC2130Protocol::TMC2130Protocol(TMC2130Stepper &driver) : drv(driver) {}
+
+void TMC2130Protocol::unknown(handler_t handler) { fallback = handler; }
+
+void TMC2130Protocol::poll(Stream &io, uint8_t max_bytes) {
+	while (max_bytes-- && io.available() > 0) {
+		feed(io.read(), io);
+	}
+}
+
+void TMC2130Protocol::feed(uint8_t c, Print &out) {
+	if (binary) {
+		frame[pos++] = c;
+		if (pos == TMC2130_PROTO_FRAME) {
+			if (execute_binary(out)) {
+				binary = false;
+				pos = 0;
+			} else resync();
+		}
+		return;
+	}
+	if (pos == 0 && c == TMC2130_PROTO_SYNC) {
+		binary = true;
+		frame[pos++] = c;
+		return;
+	}
+	if (c == '\n' || c == '\r') {
+		if (pos && !overflow) {
+			line[pos] = '\0';
+			execute_text(out);
+		}
+		pos = 0;
+		overflow = false;
+		return;
+	}
+	if (pos < TMC2130_PROTO_LINE) line[pos++] = c;
+	else overflow = true;
+}
+
+void TMC2130Protocol::execute_text(Print &out) {
+	// Split "<name> <value>" in place
+	char *arg = strchr(line, ' ');
+	bool has_arg = false;
+	int32_t value = 0;
+	if (arg) {
+		*arg++ = '\0';
+		char *end;
+		value = strtol(arg, &end, 0);
+		has_arg = (end != arg);
+	}
+
+	int16_t id = find(line);
+	if (id < 0) {
+		if (!fallback || !fallback(line, value, has_arg, out))
+			out.println(F("Invalid command!"));
+		return;
+	}
+	if (has_arg && !set(id, value)) {
+		out.println(F("Read only!"));
+		return;
+	}
+	get(id, value);
+	reply_text(out, line, value);
+}
+
+// Returns false without replying when the frame fails the CRC check
+bool TMC2130Protocol::execute_binary(Print &out) {
+	uint8_t cmd, id;
+	int32_t value;
+	if (!decode(frame, cmd, id, value)) return false;
+	bool ok;
+	switch (cmd) {
+		case TMC2130_PROTO_SET:		ok = set(id, value) && get(id, value); break;
+		case TMC2130_PROTO_GET:		ok = get(id, value); break;
+		case TMC2130_PROTO_COUNT:	value = table_size; ok = true; break;
+		default:					ok = false;
+	}
+	encode(frame, cmd | (ok ? TMC2130_PROTO_OK : TMC2130_PROTO_ERR), id, value);
+	out.write(frame, TMC2130_PROTO_FRAME);
+	return true;
+}
+
+/*
+	The sync byte that started a bad frame may have been noise or a
+	value byte. Slide one byte at a time to the next sync byte in the
+	buffer and keep collecting from there, so a frame starting inside
+	the bad one is not lost.
+*/
+void TMC2130Protocol::resync() {
+	uint8_t skip = 1;
+	while (skip < pos && frame[skip] != TMC2130_PROTO_SYNC) skip++;
+	pos -= skip;
+	memmove(frame, frame + skip, pos);
+	binary = (pos != 0);
+}
+
+bool TMC2130Protocol::set(uint8_t id, int32_t value) {
+	if (id >= table_size) return false;
+	param_t p = entry(id);
+	if (!p.set) return false;
+	p.set(drv, value);
+	return true;
+}
+
+bool TMC2130Protocol::get(uint8_t id, int32_t &value) {
+	if (id >= table_size) return false;
+	value = entry(id).get(drv);
+	return true;
+}
+
+uint8_t TMC2130Protocol::params() { return table_size; }
+
+int16_t TMC2130Protocol::find(const char *name) {
+	for (uint8_t id = 0; id < table_size; id++) {
+		if (strcmp_P(name, entry(id).name) == 0) return id;
+	}
+	return -1;
+}
+
+bool TMC2130Protocol::name(uint8_t id, char *buf, uint8_t len) {
+	if (id >= table_size || !len) return false;
+	const char *name = entry(id).name;
+	uint8_t i = 0;
+	for (; i < len-1; i++) {
+		buf[i] = pgm_read_byte(name + i);
+		if (!buf[i]) break;
+	}
+	buf[i] = '\0';
+	return true;
+}
+
+bool TMC2130Protocol::writable(uint8_t id) { return id < table_size && entry(id).set; }
+
+void TMC2130Protocol::encode(uint8_t *frame, uint8_t cmd, uint8_t id, int32_t value) {
+	frame[0] = TMC2130_PROTO_SYNC;
+	frame[1] = cmd;
+	frame[2] = id;
+	frame[3] = (uint32_t)value >> 24;
+	frame[4] = (uint32_t)value >> 16;
+	frame[5] = (uint32_t)value >>  8;
+	frame[6] = (uint32_t)value;
+	frame[7] = crc8(frame, TMC2130_PROTO_FRAME-1);
+}
+
+bool TMC2130Protocol::decode(const uint8_t *frame, uint8_t &cmd, uint8_t &id, int32_t &value) {
+	if (frame[0] != TMC2130_PROTO_SYNC || crc8(frame, TMC2130_PROTO_FRAME-1) != frame[7]) return false;
+	cmd = frame[1];
+	id = frame[2];
+	value = (uint32_t)frame[3] << 24 | (uint32_t)frame[4] << 16 | (uint32_t)frame[5] << 8 | frame[6];
+	return true;
+}
+
+// CRC-8, polynomial x^8+x^2+x+1
+uint8_t TMC2130Protocol::crc8(const uint8_t *data, uint8_t len) {
+	uint8_t crc = 0;
+	while (len--) {
+		crc ^= *data++;
+		for (uint8_t b = 0; b < 8; b++) {
+			crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+		}
+	}
+	return crc;
+}
@@ -0,0 +1,168 @@
+#include "TMC2130Stepper_RESONANCE.h"
+#include "TMC2130Stepper_MACROS.h"
+#include <math.h>
+
+#define RESONANCE_NEIGHBOURS	2	// Bins on each side forming the baseline
+#define RESONANCE_NOISE			8	// SG_RESULT deviation that is always tolerated
+
+namespace {
+	// Median of up to 2*RESONANCE_NEIGHBOURS values, n > 0
+	uint16_t median(uint16_t *v, uint8_t n) {
+		for (uint8_t i = 1; i < n; i++) {
+			for (uint8_t j = i; j && v[j-1] > v[j]; j--) {
+				uint16_t t = v[j]; v[j] = v[j-1]; v[j-1] = t;
+			}
+		}
+		return n & 1 ? v[n/2] : (v[n/2-1] + v[n/2]) / 2;
+	}
+}
+
+TMC2130Resonance::TMC2130Resonance(TMC2130Stepper &driver) : drv(driver) {
+	clear();
+}
+
+void TMC2130Resonance::clear() {
+	memset(table, 0, sizeof(table));
+	_bins = 0;
+}
+
+/*
+	Runs the sweep from v_min to v_max steps/s, slowest bin first. Each bin
+	gets `dwell_ms`: the first quarter to let the speed settle, the rest
+	to sample every `interval_ms`. run(0) stops the motor at the end.
+	A bin spans at least 1 step/s, so a narrow range gets fewer bins.
+	Returns false when the arguments do not describe a range.
+*/
+bool TMC2130Resonance::map(void (*run)(uint16_t steps_per_s), uint16_t v_min, uint16_t v_max,
+	uint8_t bins, uint16_t dwell_ms, uint8_t interval_ms) {
+	clear();
+	if (!bins || v_max <= v_min || !interval_ms) return false;
+	_bins = min(bins, (uint8_t)TMC2130_RESONANCE_BINS);
+	if (v_max - v_min < _bins) _bins = v_max - v_min;
+	_v_min = v_min;
+	_v_max = v_max;
+
+	for (uint8_t i = 0; i < _bins; i++) {
+		run(bin_speed(i));
+		delay(dwell_ms / 4);
+
+		uint32_t sg_sum = 0, sg_sq = 0, pwm_sum = 0, cs_sum = 0;
+		uint16_t n = 0;
+		uint8_t stalls = 0;
+		uint32_t start = millis();
+		do {
+			uint32_t drv_status = drv.DRV_STATUS();
+			uint16_t sg = drv_status & SG_RESULT_bm;
+			sg_sum += sg;
+			sg_sq += (uint32_t)sg * sg;
+			cs_sum += (drv_status & CS_ACTUAL_bm) >> CS_ACTUAL_bp;
+			pwm_sum += drv.PWM_SCALE();
+			if ((drv_status & STALLGUARD_bm) && stalls < 0xFF) stalls++;
+			n++;
+			delay(interval_ms);
+		} while (millis() - start < (uint16_t)(dwell_ms - dwell_ms / 4) && n < 0xFFF);
+
+		TMC2130_resonance_bin_t &b = table[i];
+		float mean = (float)sg_sum / n;
+		float var = (float)sg_sq / n - mean * mean;
+		b.sg = mean + 0.5;
+		b.sg_dev = var > 0 ? sqrt(var) + 0.5 : 0;
+		b.pwm = (pwm_sum + n/2) / n;
+		b.cs = (cs_sum + n/2) / n;
+		b.stalls = stalls;
+	}
+	run(0);
+	classify();
+	return true;
+}
+
+// Marks the resonant bins. Can be called again with other thresholds on the recorded table.
+void TMC2130Resonance::classify(uint8_t drop_percent, uint8_t pwm_rise) {
+	for (uint8_t i = 0; i < _bins; i++) {
+		uint16_t sg[2*RESONANCE_NEIGHBOURS], dev[2*RESONANCE_NEIGHBOURS], pwm[2*RESONANCE_NEIGHBOURS];
+		uint8_t n = 0;
+		for (int8_t j = i - RESONANCE_NEIGHBOURS; j <= i + RESONANCE_NEIGHBOURS; j++) {
+			if (j < 0 || j >= _bins || j == i) continue;
+			sg[n] = table[j].sg;
+			dev[n] = table[j].sg_dev;
+			pwm[n] = table[j].pwm;
+			n++;
+		}
+		TMC2130_resonance_bin_t &b = table[i];
+		b.resonant = b.stalls > 0;
+		if (!n) continue;
+		uint16_t sg_base = median(sg, n);
+		uint16_t dev_base = median(dev, n);
+		uint16_t pwm_base = median(pwm, n);
+		if ((uint32_t)b.sg * 100 < (uint32_t)sg_base * (100 - drop_percent)) b.resonant = true;
+		if (b.sg_dev > 2 * dev_base + RESONANCE_NOISE) b.resonant = true;
+		if (b.pwm > pwm_base + pwm_rise) b.resonant = true;
+	}
+}
+
+uint8_t TMC2130Resonance::bins() { return _bins; }
+const TMC2130_resonance_bin_t& TMC2130Resonance::bin(uint8_t index) { return table[min(index, (uint8_t)(TMC2130_RESONANCE_BINS-1))]; }
+
+// The first and the last speed bin_of() puts into a bin, so the edges round up
+uint16_t TMC2130Resonance::bin_low(uint8_t index) 	{ return _v_min + ((uint32_t)(_v_max - _v_min) * index + _bins - 1) / _bins; }
+uint16_t TMC2130Resonance::bin_high(uint8_t index) 	{ return index + 1 < _bins ? bin_low(index + 1) - 1 : _v_max; }
+uint16_t TMC2130Resonance::bin_speed(uint8_t index) { return ((uint32_t)bin_low(index) + bin_high(index)) / 2; }
+
+// -1 when the speed was not mapped
+int16_t TMC2130Resonance::bin_of(uint16_t steps_per_s) {
+	if (!_bins || steps_per_s < _v_min || steps_per_s > _v_max) return -1;
+	uint8_t i = (uint32_t)(steps_per_s - _v_min) * _bins / (_v_max - _v_min);
+	return min(i, (uint8_t)(_bins - 1));
+}
+
+bool TMC2130Resonance::safe(uint16_t steps_per_s) {
+	int16_t i = bin_of(steps_per_s);
+	return i < 0 || !table[i].resonant;
+}
+
+/*
+	The closest speed that is not in a resonant bin: the edge of the
+	nearest safe bin below or above. On a tie the lower speed wins.
+	When there is no safe bin in the map, the nearest speed outside it.
+	The speed itself when the map covers 0..65535 and is all resonant.
+*/
+uint16_t TMC2130Resonance::nearest_safe(uint16_t steps_per_s) {
+	int16_t i = bin_of(steps_per_s);
+	if (i < 0 || !table[i].resonant) return steps_per_s;
+
+	int16_t lo = i, hi = i;
+	while (lo >= 0 && table[lo].resonant) lo--;
+	while (hi < _bins && table[hi].resonant) hi++;
+
+	// Below v_min and above v_max count as safe
+	bool has_below = lo >= 0 || _v_min;
+	bool has_above = hi < _bins || _v_max < 0xFFFF;
+	uint16_t below = lo >= 0 ? bin_high(lo) : _v_min - 1;
+	uint16_t above = hi < _bins ? bin_low(hi) : _v_max + 1;
+	if (!has_below) return has_above ? above : steps_per_s;
+	if (!has_above) return below;
+	return (steps_per_s - below <= above - steps_per_s) ? below : above;
+}
+
+// Number of runs of adjacent resonant bins
+uint8_t TMC2130Resonance::bands() {
+	uint8_t n = 0;
+	for (uint8_t i = 0; i < _bins; i++) {
+		if (table[i].resonant && (i == 0 || !table[i-1].resonant)) n++;
+	}
+	return n;
+}
+
+// Speed range of the index'th resonant band, both ends included, slowest first
+bool TMC2130Resonance::band(uint8_t index, uint16_t &from, uint16_t &to) {
+	for (uint8_t i = 0; i < _bins; i++) {
+		if (!table[i].resonant || (i && table[i-1].resonant)) continue;
+		if (index--) continue;
+		uint8_t j = i;
+		while (j + 1 < _bins && table[j+1].resonant) j++;
+		from = bin_low(i);
+		to = bin_high(j);
+		return true;
+	}
+	return false;
+}
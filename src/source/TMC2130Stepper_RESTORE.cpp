@@ -0,0 +1,77 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+/*
+	Recovery from a driver reset.
+
+	A dip of the motor supply resets the TMC2130 and all registers return to
+	their power on defaults while the shadow registers still hold the intended
+	configuration. Every datagram returns the reset flag in its status byte,
+	so send2130() notices the reset on the next access, counts it and calls
+	restore(). Detection can be turned off with auto_restore(false).
+
+	restore() writes all writable shadow registers back in one burst of
+	datagrams and clears GSTAT.reset. The MSLUT registers are skipped as the
+	library never writes them and the chip defaults are the ones in use.
+
+	Each access restores at most once. A read is repeated once after the
+	restore. When that read still sees the reset flag, e.g. with the
+	supply still down or a bus stuck at 0xFF, the failure is counted in
+	restore_failures() and the value read is returned as it is. The next
+	access tries again.
+*/
+void TMC2130Stepper::restore() {
+	_restoring = true;
+	WRITE_REG(GCONF);
+	WRITE_REG(IHOLD_IRUN);
+	WRITE_REG(TPOWERDOWN);
+	WRITE_REG(TPWMTHRS);
+	WRITE_REG(TCOOLTHRS);
+	WRITE_REG(THIGH);
+	WRITE_REG(XDIRECT);
+	WRITE_REG(VDCMIN);
+	WRITE_REG(CHOPCONF);
+	WRITE_REG(COOLCONF);
+	WRITE_REG(DCCTRL);
+	WRITE_REG(PWMCONF);
+	WRITE_REG(ENCM_CTRL);
+	GSTAT(RESET_bm); // Write 1 to clear
+	_restoring = false;
+}
+
+void TMC2130Stepper::auto_restore(bool enable) { _auto_restore = enable; }
+bool TMC2130Stepper::auto_restore() { return _auto_restore; }
+uint16_t TMC2130Stepper::resets() { return reset_count; }
+uint16_t TMC2130Stepper::restore_failures() { return restore_fails; }
+
+// Called by an access that saw the reset flag
+void TMC2130Stepper::recover(uint8_t addressByte, uint32_t *config) {
+	reset_count++;
+	restore();
+	if (addressByte >> 7) return;
+	_restoring = true; // No second restore from the repeated read
+	send2130(addressByte, config);
+	_restoring = false;
+	if (status_response & STATUS_RESET_bm) restore_fails++;
+}
+
+// Last written value of a register without accessing the bus, 0 if it has no shadow
+uint32_t TMC2130Stepper::shadow(uint8_t address) {
+	switch (address & 0x7F) {
+		case REG_GCONF:			return GCONF_sr;
+		case REG_GSTAT:			return GSTAT_sr;
+		case REG_IHOLD_IRUN:	return IHOLD_IRUN_sr;
+		case REG_TPOWERDOWN:	return TPOWERDOWN_sr;
+		case REG_TPWMTHRS:		return TPWMTHRS_sr;
+		case REG_TCOOLTHRS:		return TCOOLTHRS_sr;
+		case REG_THIGH:			return THIGH_sr;
+		case REG_XDIRECT:		return XDIRECT_sr;
+		case REG_VDCMIN:		return VDCMIN_sr;
+		case REG_CHOPCONF:		return CHOPCONF_sr;
+		case REG_COOLCONF:		return COOLCONF_sr;
+		case REG_DCCTRL:		return DCCTRL_sr;
+		case REG_PWMCONF:		return PWMCONF_sr;
+		case REG_ENCM_CTRL:		return ENCM_CTRL_sr;
+		default:				return 0;
+	}
+}
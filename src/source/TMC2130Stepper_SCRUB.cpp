@@ -0,0 +1,115 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+using namespace TMC2130_n;
+
+#define SCRUB_VERIFY 	3	// Registers that read back, first in the rotation
+#define SCRUB_ALL 		13
+
+// Rotation order. The write only registers are only refreshed with scrub_refresh(true).
+static const uint8_t scrub_regs[SCRUB_ALL] PROGMEM = {
+	REG_GCONF, REG_CHOPCONF, REG_XDIRECT,
+	REG_IHOLD_IRUN, REG_TPOWERDOWN, REG_TPWMTHRS, REG_TCOOLTHRS, REG_THIGH,
+	REG_VDCMIN, REG_COOLCONF, REG_DCCTRL, REG_PWMCONF, REG_ENCM_CTRL
+};
+
+static uint32_t readback_mask(uint8_t address) {
+	switch (address) {
+		case REG_GCONF: 	return GCONF_r::mask;
+		case REG_CHOPCONF: 	return CHOPCONF_r::mask;
+		case REG_XDIRECT: 	return XDIRECT_r::mask;
+		default: 			return 0;
+	}
+}
+
+/*
+	Background check of the chip configuration against the shadow
+	registers, against corruption by noise on the SPI lines.
+
+	Every call checks the next register of the rotation GCONF, CHOPCONF,
+	XDIRECT, and rewrites it from the shadow when it differs. Only these
+	three can be read back. The others are write only, scrub_refresh(true)
+	adds them to the rotation and rewrites them blindly.
+
+	With budget_us 0 one register is handled per call. Otherwise registers
+	are handled until the next one might not fit into the budget, but at
+	most one full rotation. Consecutive reads are pipelined: the datagram
+	that returns a register requests the next one, so a check mostly costs
+	one datagram. The value compared is the one latched by that request,
+	which may be from the previous call. Returns the number of mismatches
+	repaired.
+*/
+uint8_t TMC2130Stepper::scrub(uint16_t budget_us) {
+	if (!arbiter->acquire()) return 0;
+	uint8_t rotation = scrub_wo ? SCRUB_ALL : SCRUB_VERIFY;
+	uint32_t start = micros();
+	uint8_t frames = 0;
+	uint8_t repaired = 0;
+	bool reset = false;
+
+	for (uint8_t handled = 0; handled < rotation; ) {
+		if (scrub_pos >= rotation) scrub_pos = 0;
+		uint8_t address = pgm_read_byte(&scrub_regs[scrub_pos]);
+		uint32_t value = 0;
+
+		if (scrub_pos >= SCRUB_VERIFY) {
+			transfer2130(TMC2130_WRITE|address, shadow(address));
+			frames++;
+		} else {
+			if (last_frame != (TMC2130_READ|address)) {
+				transfer2130(TMC2130_READ|address, 0);
+				frames++;
+			}
+			uint8_t next = pgm_read_byte(&scrub_regs[(scrub_pos + 1) % SCRUB_VERIFY]);
+			value = transfer2130(TMC2130_READ|next, 0);
+			frames++;
+		}
+		// After a reset every register differs, restore() below takes care of it
+		if (status_response & STATUS_RESET_bm) {
+			reset = true;
+			break;
+		}
+		if (scrub_pos < SCRUB_VERIFY) {
+			uint32_t mask = readback_mask(address);
+			scrub_count++;
+			if ((value & mask) != (shadow(address) & mask)) {
+				if (scrub_errors[scrub_pos] < 0xFFFF) scrub_errors[scrub_pos]++;
+				transfer2130(TMC2130_WRITE|address, shadow(address));
+				frames++;
+				repaired++;
+			}
+		}
+		scrub_pos++;
+		handled++;
+
+		uint32_t spent = micros() - start;
+		uint32_t per_frame = spent / frames;
+		if (per_frame > scrub_frame_us) scrub_frame_us = per_frame > 0xFFFF ? 0xFFFF : per_frame;
+		// Worst case for the next register: request, reply and repair
+		if (!budget_us || spent + 3UL * scrub_frame_us > budget_us) break;
+	}
+	arbiter->release();
+
+	if (reset && _started && _auto_restore && !_restoring) {
+		reset_count++;
+		restore();
+	}
+	return repaired;
+}
+
+void TMC2130Stepper::scrub_refresh(bool enable) { scrub_wo = enable; }
+
+// Mismatches found in GCONF, CHOPCONF or XDIRECT since scrub_clear()
+uint16_t TMC2130Stepper::scrub_mismatches(uint8_t address) {
+	for (uint8_t i = 0; i < SCRUB_VERIFY; i++) {
+		if (pgm_read_byte(&scrub_regs[i]) == (address & 0x7F)) return scrub_errors[i];
+	}
+	return 0;
+}
+
+uint32_t TMC2130Stepper::scrub_checks() { return scrub_count; }
+
+void TMC2130Stepper::scrub_clear() {
+	memset(scrub_errors, 0, sizeof(scrub_errors));
+	scrub_count = 0;
+}
@@ -0,0 +1,82 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+// Scratch pattern for the readback check. XDIRECT has no effect unless
+// direct_mode is set, so it can be written freely during normal operation.
+#define SELFTEST_PATTERN	0x015500AAUL
+#define SELFTEST_PATTERN_bm	(COIL_A_bm|COIL_B_bm)
+#define SELFTEST_SETTLE_MS	10
+
+/*
+	Bring-up check for wiring and driver health.
+
+	1. IOIN version byte must read TMC2130_VERSION. A dead MISO line reads
+	   0x00 or 0xFF.
+	2. A scratch pattern is written to XDIRECT and read back, proving the
+	   MOSI/SCK/CS path. Skipped while direct_mode is active.
+	3. GSTAT drv_err and uv_cp are cleared and read again so only a
+	   persisting fault is reported. Reading GSTAT also clears the reset
+	   flag, it is reported in result.reset but does not fail the test.
+	4. The driver is enabled for a short moment and DRV_STATUS is checked
+	   for short to ground, open load and overtemperature. Open load is
+	   only detected reliably while the motor is moving. With toff == 0
+	   the bridges stay off, so this step is not run and result.energised
+	   stays false.
+
+	Every step checks the time budget and the test stops early with
+	result.timeout set when it runs out.
+	Returns true when all checks ran and passed.
+*/
+bool TMC2130Stepper::selfTest(TMC2130_selftest_t &result, uint16_t budget_ms) {
+	uint32_t start = millis();
+	memset(&result, 0, sizeof(result));
+
+	result.version = version();
+	result.spi = (result.version == TMC2130_VERSION);
+	if (!result.spi) goto done;
+
+	if (millis() - start > budget_ms) { result.timeout = true; goto done; }
+	if (GCONF() & DIRECT_MODE_bm) {
+		result.readback = true;
+	} else {
+		uint32_t saved = XDIRECT_sr;
+		XDIRECT(SELFTEST_PATTERN);
+		result.readback = ((XDIRECT() & SELFTEST_PATTERN_bm) == SELFTEST_PATTERN);
+		XDIRECT(saved);
+	}
+
+	if (millis() - start > budget_ms) { result.timeout = true; goto done; }
+	{
+		uint8_t gstat = GSTAT();
+		result.reset = gstat & RESET_bm;
+		if (gstat & (UV_CP_bm|DRV_ERR_bm)) {
+			GSTAT(UV_CP_bm|DRV_ERR_bm); // Write 1 to clear
+			gstat = GSTAT();
+			result.uv_cp = gstat & UV_CP_bm;
+			result.drv_err = gstat & DRV_ERR_bm;
+		}
+	}
+
+	if (millis() - start > budget_ms) { result.timeout = true; goto done; }
+	if (CHOPCONF() & TOFF_bm) { // toff == 0 keeps the bridges off regardless of EN
+		bool was_disabled = digitalRead(_pinEN);
+		digitalWrite(_pinEN, LOW);
+		uint32_t energised = millis();
+		while (millis() - energised < SELFTEST_SETTLE_MS && millis() - start < budget_ms);
+		uint32_t drv_status = DRV_STATUS();
+		if (was_disabled) digitalWrite(_pinEN, HIGH);
+
+		result.energised = true;
+		result.ot 	= drv_status & OT_bm;
+		result.s2ga = drv_status & S2GA_bm;
+		result.s2gb = drv_status & S2GB_bm;
+		result.ola 	= drv_status & OLA_bm;
+		result.olb 	= drv_status & OLB_bm;
+		if (millis() - start > budget_ms) result.timeout = true;
+	}
+
+done:
+	result.duration = millis() - start;
+	return result.spi && result.readback && result.energised && !result.timeout &&
+		!(result.uv_cp || result.drv_err || result.ot || result.s2ga || result.s2gb || result.ola || result.olb);
+}
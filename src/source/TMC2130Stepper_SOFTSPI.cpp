@@ -0,0 +1,195 @@
+#include "TMC2130Stepper_SOFTSPI.h"
+
+#define PIN_NC 0xFF
+
+/*
+	Interrupts are off for one datagram and come back in the state they
+	were in, so a transfer from an interrupt handler does not turn them on
+	inside it. Where the state cannot be saved they are left on: the chip
+	does not mind a stretched clock phase, and the arbiter keeps other
+	accesses to the bus out.
+*/
+#if defined(ARDUINO_ARCH_AVR)
+	#define SOFTSPI_LOCK()		uint8_t sreg = SREG; cli()
+	#define SOFTSPI_UNLOCK()	SREG = sreg
+#elif defined(__ARM_ARCH_6M__) || defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__) || defined(__ARM_ARCH_8M_BASE__) || defined(__ARM_ARCH_8M_MAIN__)
+	// Cortex-M: PRIMASK is 1 while interrupts are masked
+	#define SOFTSPI_LOCK()		uint32_t primask; __asm__ volatile ("mrs %0, primask\n cpsid i" : "=r" (primask) :: "memory")
+	#define SOFTSPI_UNLOCK()	__asm__ volatile ("msr primask, %0" :: "r" (primask) : "memory")
+#elif defined(ARDUINO_ARCH_ESP8266)
+	#define SOFTSPI_LOCK()		uint32_t ps = xt_rsil(15)
+	#define SOFTSPI_UNLOCK()	xt_wsr_ps(ps)
+#else
+	#define SOFTSPI_LOCK()
+	#define SOFTSPI_UNLOCK()
+#endif
+
+// The arbiter has no constructor, value initialisation zeroes it on the stack too
+TMC2130SoftSPI::TMC2130SoftSPI(uint8_t pinSCK, uint8_t pinMOSI, uint8_t pinMISO) : arbiter() {
+	sck.pin = pinSCK;
+	default_mosi = pinMOSI;
+	default_miso = pinMISO;
+}
+
+/*
+	Adds a driver as the next channel and installs the bus as its backend
+	and the bus' arbiter as its arbiter.
+	MOSI and MISO default to the pins given to the constructor. read_all()
+	needs a MOSI and a MISO pin of its own for every channel.
+	Returns the channel number or -1 when all channels are taken.
+*/
+int8_t TMC2130SoftSPI::attach(TMC2130Stepper &driver, uint8_t pinCS, uint8_t pinMOSI, uint8_t pinMISO) {
+	if (count >= TMC2130_SOFTSPI_CHANNELS) return -1;
+	if (!count) {
+		sck.attach(sck.pin, OUTPUT);
+		sck.high();
+	}
+	channel_t &c = ch[count];
+	c.bus = this;
+	c.driver = &driver;
+	c.cs.attach(pinCS, OUTPUT);
+	c.cs.high();
+	c.mosi.attach(pinMOSI == PIN_NC ? default_mosi : pinMOSI, OUTPUT);
+	c.miso.attach(pinMISO == PIN_NC ? default_miso : pinMISO, INPUT);
+	for (uint8_t i = 0; i < count; i++) {
+		if (ch[i].mosi.pin == c.mosi.pin || ch[i].miso.pin == c.miso.pin) shared = true;
+	}
+	driver.bus_backend(backend, &c);
+	driver.bus_arbiter(arbiter);
+	driver.resync();
+	return count++;
+}
+
+// Extra delay per clock phase for fast cores, the TMC2130 allows up to 4MHz
+void TMC2130SoftSPI::half_period(uint8_t us) { _half_period = us; }
+
+uint8_t TMC2130SoftSPI::channels() { return count; }
+TMC2130Bus& TMC2130SoftSPI::bus_arbiter() { return arbiter; }
+
+void TMC2130SoftSPI::backend(void *ctx, uint8_t *datagram) {
+	channel_t *c = static_cast<channel_t*>(ctx);
+	c->bus->transfer(c - c->bus->ch, datagram);
+}
+
+void TMC2130SoftSPI::wait() {
+	if (_half_period) delayMicroseconds(_half_period);
+}
+
+// One byte, MSB first. The chip shifts out on the falling edge and samples on the rising edge.
+uint8_t TMC2130SoftSPI::shift(channel_t &c, uint8_t out) {
+	uint8_t in = 0;
+	#define SOFTSPI_BIT(B) \
+		sck.low(); \
+		c.mosi.write(out & (1<<B)); \
+		wait(); \
+		sck.high(); \
+		if (c.miso.read()) in |= 1<<B; \
+		wait();
+	SOFTSPI_BIT(7) SOFTSPI_BIT(6) SOFTSPI_BIT(5) SOFTSPI_BIT(4)
+	SOFTSPI_BIT(3) SOFTSPI_BIT(2) SOFTSPI_BIT(1) SOFTSPI_BIT(0)
+	#undef SOFTSPI_BIT
+	return in;
+}
+
+void TMC2130SoftSPI::transfer(uint8_t channel, uint8_t *datagram) {
+	channel_t &c = ch[channel];
+	SOFTSPI_LOCK();
+	c.cs.low();
+	datagram[0] = shift(c, datagram[0]);
+	datagram[1] = shift(c, datagram[1]);
+	datagram[2] = shift(c, datagram[2]);
+	datagram[3] = shift(c, datagram[3]);
+	datagram[4] = shift(c, datagram[4]);
+	c.cs.high();
+	SOFTSPI_UNLOCK();
+}
+
+/*
+	Shifts datagrams[i] through channel i, all channels at once. Channels
+	sharing a MOSI pin receive the data of the last of them, so give each
+	channel its own MOSI and MISO pin. The drivers are not aware of these
+	datagrams, writes bypass their shadow registers.
+*/
+void TMC2130SoftSPI::transfer_all(uint8_t (*datagrams)[5]) {
+	if (!count) return;
+#if defined(ARDUINO_ARCH_AVR)
+	// MOSI pins on the same port as the first channel are written together
+	volatile uint8_t *port = ch[0].mosi.out;
+	uint8_t port_mask = 0;
+	for (uint8_t i = 0; i < count; i++) {
+		if (ch[i].mosi.out == port) port_mask |= ch[i].mosi.mask;
+	}
+#endif
+	SOFTSPI_LOCK();
+	for (uint8_t i = 0; i < count; i++) ch[i].cs.low();
+	for (uint8_t byte = 0; byte < 5; byte++) {
+		uint8_t in[TMC2130_SOFTSPI_CHANNELS] = {0};
+		for (uint8_t bit = 0x80; bit; bit >>= 1) {
+			sck.low();
+#if defined(ARDUINO_ARCH_AVR)
+			uint8_t bits = 0;
+			for (uint8_t i = 0; i < count; i++) {
+				bool on = datagrams[i][byte] & bit;
+				if (ch[i].mosi.out == port) { if (on) bits |= ch[i].mosi.mask; }
+				else ch[i].mosi.write(on);
+			}
+			*port = (*port & ~port_mask) | bits;
+#else
+			for (uint8_t i = 0; i < count; i++) ch[i].mosi.write(datagrams[i][byte] & bit);
+#endif
+			wait();
+			sck.high();
+			for (uint8_t i = 0; i < count; i++) {
+				if (ch[i].miso.read()) in[i] |= bit;
+			}
+			wait();
+		}
+		for (uint8_t i = 0; i < count; i++) datagrams[i][byte] = in[i];
+	}
+	for (uint8_t i = 0; i < count; i++) ch[i].cs.high();
+	SOFTSPI_UNLOCK();
+}
+
+// The arbiter of a channel's driver, NULL when an earlier channel has the same one
+TMC2130Bus* TMC2130SoftSPI::arbiter_of(uint8_t channel) {
+	TMC2130Bus *a = &ch[channel].driver->bus_arbiter();
+	for (uint8_t i = 0; i < channel; i++) {
+		if (&ch[i].driver->bus_arbiter() == a) return NULL;
+	}
+	return a;
+}
+
+// Releases the arbiters taken for the first `channels` channels, last taken first
+void TMC2130SoftSPI::release(uint8_t channels) {
+	while (channels--) {
+		TMC2130Bus *a = arbiter_of(channels);
+		if (a) a->release();
+	}
+}
+
+// Reads one register from every channel with two parallel datagrams.
+// False when a bus is taken or two channels share a MOSI or MISO pin.
+bool TMC2130SoftSPI::read_all(uint8_t address, uint32_t *values) {
+	if (!count || shared) return false;
+	for (uint8_t i = 0; i < count; i++) {
+		TMC2130Bus *a = arbiter_of(i);
+		if (a && !a->acquire()) {
+			release(i);
+			return false;
+		}
+	}
+	uint8_t d[TMC2130_SOFTSPI_CHANNELS][5];
+	for (uint8_t pass = 0; pass < 2; pass++) {
+		for (uint8_t i = 0; i < count; i++) {
+			d[i][0] = address & 0x7F;
+			d[i][1] = d[i][2] = d[i][3] = d[i][4] = 0;
+		}
+		transfer_all(d);
+	}
+	for (uint8_t i = 0; i < count; i++) {
+		values[i] = (uint32_t)d[i][1] << 24 | (uint32_t)d[i][2] << 16 | (uint32_t)d[i][3] << 8 | d[i][4];
+		ch[i].driver->resync();
+	}
+	release(count);
+	return true;
+}
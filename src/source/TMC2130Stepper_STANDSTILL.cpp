@@ -0,0 +1,100 @@
+#include "TMC2130Stepper_STANDSTILL.h"
+
+TMC2130Standstill::TMC2130Standstill(uint32_t reduce_ms, uint8_t reduce_percent, uint32_t off_ms) {
+	_reduce_ms = reduce_ms;
+	_reduce_percent = reduce_percent;
+	_off_ms = off_ms;
+}
+
+/*
+	R_coil is the resistance of one coil, 0 skips the energy estimate.
+	tpowerdown is in units of 2^18 clock cycles (about 22ms at 12MHz).
+	The current ihold setting is taken as the nominal hold current. The
+	axis counts as idle since `now`.
+*/
+bool TMC2130Standstill::add(TMC2130Stepper &driver, float R_coil, uint8_t tpowerdown, uint8_t iholddelay, uint32_t now) {
+	if (count >= TMC2130_STANDSTILL_MAX_DRIVERS) return false;
+	driver.TPOWERDOWN(tpowerdown);
+	driver.iholddelay(iholddelay);
+	axis_t &a = axes[count++];
+	a.driver = &driver;
+	a.R = R_coil;
+	a.energy = 0;
+	a.ihold_nominal = driver.ihold();
+	a.stage = STANDSTILL_HOLD;
+	a.last_move = now;
+	a.last_account = now;
+	a.powerdown_ms = (float)tpowerdown * 262144.0 / driver.fclk * 1000;
+	return true;
+}
+
+// 1 freewheel, 2 coils shorted by the low side, 3 by the high side switches
+void TMC2130Standstill::freewheel(uint8_t mode) { _freewheel = mode; }
+
+/*
+	Coil current for the time since the last call, as set in the driver.
+	Both coils carry I_rms on average.
+*/
+void TMC2130Standstill::account(axis_t &a, uint32_t now) {
+	uint32_t dt = now - a.last_account;
+	a.last_account = now;
+	if (!a.R || a.stage == STANDSTILL_OFF) return;
+
+	TMC2130Stepper &d = *a.driver;
+	bool hold = a.stage != STANDSTILL_MOVING && now - a.last_move >= a.powerdown_ms;
+	uint8_t cs = hold ? d.ihold() : d.irun();
+	float I_rms = (cs+1) / 32.0 * (d.vsense() ? 0.180 : 0.325) / (d.Rsense + 0.02) / 1.41421;
+	a.energy += 2 * I_rms * I_rms * a.R * dt / 1000.0;
+}
+
+void TMC2130Standstill::apply(axis_t &a, uint8_t stage) {
+	TMC2130Stepper &d = *a.driver;
+	if (stage == a.stage) return;
+	if (a.stage == STANDSTILL_OFF) d.freewheel(0);
+	switch (stage) {
+		case STANDSTILL_MOVING:
+		case STANDSTILL_HOLD:
+			if (d.ihold() != a.ihold_nominal) d.ihold(a.ihold_nominal);
+			break;
+		case STANDSTILL_REDUCED:
+			d.ihold((uint16_t)a.ihold_nominal * _reduce_percent / 100);
+			break;
+		case STANDSTILL_OFF:
+			d.ihold(0);
+			d.freewheel(_freewheel);
+			break;
+	}
+	a.stage = stage;
+}
+
+void TMC2130Standstill::update(uint32_t now) {
+	for (uint8_t i = 0; i < count; i++) {
+		axis_t &a = axes[i];
+		account(a, now);
+		uint32_t idle = now - a.last_move;
+		uint8_t stage = a.stage;
+		if (stage == STANDSTILL_MOVING) stage = STANDSTILL_HOLD;
+		if (_reduce_ms && idle >= _reduce_ms && stage < STANDSTILL_REDUCED) stage = STANDSTILL_REDUCED;
+		if (_off_ms && idle >= _off_ms) stage = STANDSTILL_OFF;
+		apply(a, stage);
+	}
+}
+
+void TMC2130Standstill::moved(uint8_t i, uint32_t now) {
+	if (i >= count) return;
+	axis_t &a = axes[i];
+	account(a, now);
+	a.last_move = now;
+	if (a.stage != STANDSTILL_MOVING) apply(a, STANDSTILL_MOVING);
+}
+
+void TMC2130Standstill::wake(uint8_t i, uint32_t now) { moved(i, now); }
+
+uint8_t TMC2130Standstill::drivers() { return count; }
+uint8_t TMC2130Standstill::stage(uint8_t i) { return i < count ? axes[i].stage : 0; }
+uint32_t TMC2130Standstill::idle_time(uint8_t i, uint32_t now) { return i < count ? now - axes[i].last_move : 0; }
+float TMC2130Standstill::energy(uint8_t i) { return i < count ? axes[i].energy : 0; }
+
+void TMC2130Standstill::clear_energy() {
+	for (uint8_t i = 0; i < count; i++) axes[i].energy = 0;
+}
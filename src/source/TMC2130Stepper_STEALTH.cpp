@@ -0,0 +1,120 @@
+#include "TMC2130Stepper_STEALTH.h"
+#include "TMC2130Stepper_MACROS.h"
+
+#define STEALTH_SAMPLE_MS	10	// PWM_SCALE sampling during calibration
+#define STEALTH_STABLE		5	// Consecutive samples within STEALTH_TOLERANCE
+#define STEALTH_TOLERANCE	1
+#define STEALTH_HITS		3	// Consecutive samples at the limit to flag saturation
+#define STEALTH_RELEASE		8	// Scale has to drop this far below the limit to clear
+#define TSTEP_STANDSTILL	0xFFFFFUL
+
+TMC2130Stealth::TMC2130Stealth(TMC2130Stepper &driver, uint8_t limit, uint16_t interval) : drv(driver) {
+	_limit = limit;
+	_interval = interval;
+}
+
+// Waits until PWM_SCALE stops changing or the budget runs out
+bool TMC2130Stealth::settle(uint8_t &scale, uint32_t start, uint16_t budget_ms) {
+	uint8_t stable = 0;
+	scale = drv.PWM_SCALE();
+	while (millis() - start < budget_ms) {
+		delay(STEALTH_SAMPLE_MS);
+		uint8_t s = drv.PWM_SCALE();
+		stable = (abs(s - scale) <= STEALTH_TOLERANCE) ? stable+1 : 0;
+		scale = s;
+		if (stable >= STEALTH_STABLE) return true;
+	}
+	return false;
+}
+
+/*
+	Calibration sequence:
+	1. stealthChop with pwm_autoscale is forced for all speeds (TPWMTHRS=0).
+	   pwm_grad is raised to 1 if it is 0 as the regulation needs a gradient.
+	2. run(0) keeps the motor at standstill until PWM_SCALE settles.
+	3. run(speed) moves the motor until PWM_SCALE settles again.
+	4. run(0), stealthChop and TPWMTHRS are set back to what they were.
+
+	Returns true when PWM_SCALE settled in both phases without reaching
+	the saturation limit. The settled values are kept in standstill_scale()
+	and motion_scale().
+*/
+bool TMC2130Stealth::calibrate(void (*run)(uint16_t steps_per_s), uint16_t speed, uint16_t budget_ms) {
+	uint32_t start = millis();
+	bool stealth = drv.en_pwm_mode();
+	uint32_t tpwmthrs = drv.TPWMTHRS();
+
+	drv.pwm_autoscale(true);
+	if (!drv.pwm_grad()) drv.pwm_grad(1);
+	drv.TPWMTHRS(0);
+	drv.en_pwm_mode(true);
+
+	run(0);
+	bool converged = settle(_standstill, start, budget_ms);
+	if (converged) {
+		run(speed);
+		converged = settle(_motion, start, budget_ms);
+		if (_motion >= _limit) {
+			uint32_t tstep = drv.TSTEP();
+			if (tstep != TSTEP_STANDSTILL && tstep > tstep_saturated) tstep_saturated = tstep;
+		}
+	}
+	run(0);
+
+	drv.en_pwm_mode(stealth);
+	drv.TPWMTHRS(tpwmthrs);
+	return converged && _motion < _limit;
+}
+
+/*
+	Call regularly from loop() while the motor runs in stealthChop.
+	Reads PWM_SCALE once every `interval` ms and returns saturated().
+*/
+bool TMC2130Stealth::update() {
+	uint32_t now = millis();
+	if (now - last_update < _interval) return _saturated;
+	last_update = now;
+
+	uint8_t scale = drv.PWM_SCALE();
+	if (scale > _peak) _peak = scale;
+
+	if (scale >= _limit) {
+		if (hits < STEALTH_HITS) hits++;
+		if (hits == STEALTH_HITS && !_saturated) {
+			_saturated = true;
+			_events++;
+			uint32_t tstep = drv.TSTEP();
+			if (tstep != TSTEP_STANDSTILL && tstep > tstep_saturated) tstep_saturated = tstep;
+		}
+	} else {
+		hits = 0;
+		if (scale + STEALTH_RELEASE <= _limit) _saturated = false;
+	}
+	return _saturated;
+}
+
+bool TMC2130Stealth::saturated() { return _saturated; }
+uint16_t TMC2130Stealth::events() { return _events; }
+uint8_t TMC2130Stealth::peak() { return _peak; }
+uint8_t TMC2130Stealth::standstill_scale() { return _standstill; }
+uint8_t TMC2130Stealth::motion_scale() { return _motion; }
+
+/*
+	stealthChop is used while TSTEP >= TPWMTHRS. Saturation was seen at
+	TSTEP values up to tstep_saturated, so the threshold is placed 12.5%
+	above (slower than) the slowest saturating speed. 0 when no saturation
+	was seen, which keeps stealthChop at all speeds.
+*/
+uint32_t TMC2130Stealth::suggested_threshold() {
+	if (!tstep_saturated) return 0;
+	uint32_t t = tstep_saturated + tstep_saturated/8;
+	return t > TPWMTHRS_bm ? TPWMTHRS_bm : t;
+}
+
+void TMC2130Stealth::clear() {
+	_saturated = false;
+	hits = 0;
+	_events = 0;
+	_peak = 0;
+	tstep_saturated = 0;
+}
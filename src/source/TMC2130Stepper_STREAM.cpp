@@ -0,0 +1,86 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+// Both coil currents in one XDIRECT write, -255..255 each
+void TMC2130Stepper::coil_AB(int16_t A, int16_t B) {
+	XDIRECT_sr = coil_pack(A, B);
+	WRITE_REG(XDIRECT);
+}
+
+// XDIRECT value for a pair of coil currents. Precompute stream buffers with this.
+uint32_t TMC2130Stepper::coil_pack(int16_t A, int16_t B) {
+	return TMC2130_n::COIL_B_f::set(TMC2130_n::COIL_A_f::set(0, A), B);
+}
+
+/*
+	Direct coil current streaming.
+
+	stream_begin() switches to direct_mode and stream_tick() writes the
+	next buffer entry every period_us, one datagram per sample. Entries are
+	packed XDIRECT values made with coil_pack(), so nothing is calculated
+	while streaming. The schedule is kept against the start time, so a
+	late sample does not shift the ones after it. A sample more than one
+	period late restarts the schedule and is counted in stream_stats().
+
+	Call stream_tick() as often as possible from loop() or from a timer
+	interrupt. stream_stats().frame_time gives the fastest rate the bus
+	can sustain: 1000000/frame_time samples per second.
+	extras/stream/stream_rate.cpp measures it on the host with a simulated
+	timer.
+
+	Calling stream_begin() while streaming switches to the new buffer, and
+	stream_end() still returns to the direct_mode from before the first
+	one. Returns false for an empty buffer.
+*/
+bool TMC2130Stepper::stream_begin(const uint32_t *buffer, uint16_t count, uint32_t period_us, bool repeat) {
+	if (!buffer || !count) return false;
+	if (!stream_buf) {
+		stream_direct = GCONF_sr & DIRECT_MODE_bm;
+		if (!stream_direct) direct_mode(true);
+	}
+	stream_count = count;
+	stream_pos = 0;
+	stream_period = period_us;
+	stream_repeat = repeat;
+	memset(&stream_st, 0, sizeof(stream_st));
+	stream_due = micros();
+	stream_buf = buffer;
+	return true;
+}
+
+// Returns true when a sample was written
+bool TMC2130Stepper::stream_tick() {
+	if (!stream_buf) return false;
+	uint32_t now = micros();
+	int32_t lag = now - stream_due;
+	if (lag < 0) return false;
+
+	XDIRECT_sr = stream_buf[stream_pos];
+	WRITE_REG(XDIRECT);
+	uint32_t frame_time = micros() - now;
+
+	stream_st.samples++;
+	if ((uint32_t)lag > stream_st.max_lag) stream_st.max_lag = lag;
+	if (frame_time > stream_st.frame_time) stream_st.frame_time = frame_time > 0xFFFF ? 0xFFFF : frame_time;
+	if ((uint32_t)lag > stream_period) {
+		stream_st.late++;
+		stream_due = now;
+	}
+	stream_due += stream_period;
+
+	if (++stream_pos >= stream_count) {
+		stream_pos = 0;
+		if (!stream_repeat) stream_end();
+	}
+	return true;
+}
+
+// Stops streaming and leaves direct_mode again if stream_begin() entered it
+void TMC2130Stepper::stream_end() {
+	if (!stream_buf) return;
+	stream_buf = NULL;
+	if (!stream_direct) direct_mode(false);
+}
+
+bool TMC2130Stepper::streaming() { return stream_buf != NULL; }
+const TMC2130_stream_stats_t& TMC2130Stepper::stream_stats() { return stream_st; }
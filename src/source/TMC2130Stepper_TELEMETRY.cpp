@@ -0,0 +1,170 @@
+#include "TMC2130Stepper_TELEMETRY.h"
+#include "TMC2130Stepper_MACROS.h"
+
+// Longest record: dt plus one delta per field, 5 bytes each
+#define TELEMETRY_RECORD_MAX	(5*(TELEMETRY_FIELDS+1))
+
+namespace {
+	uint8_t put_varint(uint8_t *p, uint32_t v) {
+		uint8_t n = 0;
+		while (v >= 0x80) {
+			p[n++] = v | 0x80;
+			v >>= 7;
+		}
+		p[n++] = v;
+		return n;
+	}
+
+	uint32_t zigzag(int32_t v) { return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31); }
+	int32_t unzigzag(uint32_t v) { return (int32_t)(v >> 1) ^ -(int32_t)(v & 1); }
+}
+
+TMC2130Telemetry::TMC2130Telemetry(TMC2130Stepper &driver, uint8_t *buffer, uint16_t size, uint8_t fields, uint16_t interval) :
+	drv(driver), buf(buffer), _size(size), _fields(fields), _interval(interval) {}
+
+// Call from loop(). Takes a sample every interval ms, returns true when it did.
+bool TMC2130Telemetry::update() {
+	uint32_t now = millis();
+	if (now - last_sample < _interval) return false;
+	last_sample = now;
+	sample();
+	return true;
+}
+
+// Reads the selected fields and appends a record, dropping old ones if needed
+void TMC2130Telemetry::sample() {
+	uint32_t now = millis();
+	uint32_t value[TELEMETRY_FIELDS];
+	if (_fields & (TELEMETRY_SG_RESULT|TELEMETRY_CS_ACTUAL|TELEMETRY_FLAGS)) {
+		uint32_t drv_status = drv.DRV_STATUS();
+		value[0] = (drv_status & SG_RESULT_bm) >> SG_RESULT_bp;
+		value[1] = (drv_status & CS_ACTUAL_bm) >> CS_ACTUAL_bp;
+		value[4] = (drv_status >> 24) | ((drv_status & FSACTIVE_bm) ? 0x100 : 0);
+	}
+	if (_fields & TELEMETRY_TSTEP) value[2] = drv.TSTEP();
+	if (_fields & TELEMETRY_PWM_SCALE) value[3] = drv.PWM_SCALE();
+
+	uint8_t rec[TELEMETRY_RECORD_MAX];
+	if (!count) {
+		// Empty buffer, the deltas of the first record start from the last state
+		base_time = last_time;
+		memcpy(base, last, sizeof(base));
+	}
+	uint8_t len = encode(rec, now, value);
+	if (len > _size) return;	// Never fits, the next record keeps the deltas from the last stored one
+	last_time = now;
+	for (uint8_t f = 0; f < TELEMETRY_FIELDS; f++) {
+		if (_fields & (1<<f)) last[f] = value[f];
+	}
+	while (_size - _used < len) consume(NULL);
+
+	for (uint8_t i = 0; i < len; i++) {
+		buf[head] = rec[i];
+		if (++head == _size) head = 0;
+	}
+	_used += len;
+	count++;
+}
+
+// Deltas from the last stored record. Leaves the encoder state as it is.
+uint8_t TMC2130Telemetry::encode(uint8_t *rec, uint32_t now, const uint32_t *value) {
+	uint8_t len = put_varint(rec, now - last_time);
+	for (uint8_t f = 0; f < TELEMETRY_FIELDS; f++) {
+		if (!(_fields & (1<<f))) continue;
+		len += put_varint(rec + len, zigzag(value[f] - last[f]));
+	}
+	return len;
+}
+
+uint8_t TMC2130Telemetry::next(uint16_t &pos) {
+	uint8_t b = buf[pos];
+	if (++pos == _size) pos = 0;
+	return b;
+}
+
+uint32_t TMC2130Telemetry::read_varint(uint16_t &pos) {
+	uint32_t v = 0;
+	uint8_t shift = 0, b;
+	do {
+		b = next(pos);
+		v |= (uint32_t)(b & 0x7F) << shift;
+		shift += 7;
+	} while (b & 0x80);
+	return v;
+}
+
+uint16_t TMC2130Telemetry::record_length(uint16_t pos) {
+	uint16_t len = 0;
+	for (uint8_t f = 0; f <= TELEMETRY_FIELDS; f++) {
+		if (f && !(_fields & (1<<(f-1)))) continue;
+		while (next(pos) & 0x80) len++;
+		len++;
+	}
+	return len;
+}
+
+// Removes the oldest record and moves the base past it, optionally copying it to out
+void TMC2130Telemetry::consume(Print *out) {
+	uint16_t start = tail;
+	uint16_t len = record_length(tail);
+	base_time += read_varint(tail);
+	for (uint8_t f = 0; f < TELEMETRY_FIELDS; f++) {
+		if (_fields & (1<<f)) base[f] += unzigzag(read_varint(tail));
+	}
+	if (out) {
+		for (uint16_t i = 0; i < len; i++) out->write(next(start));
+	} else {
+		_dropped++;
+		dropped_chunk++;
+	}
+	_used -= len;
+	count--;
+}
+
+/*
+	Writes the oldest records as one chunk of at most max_bytes and removes
+	them from the buffer. Returns the number of records written.
+*/
+uint16_t TMC2130Telemetry::drain(Print &out, uint16_t max_bytes) {
+	if (!count) return 0;
+	uint8_t header[8 + 5*(TELEMETRY_FIELDS+4)];
+	uint8_t len = 0;
+	header[len++] = TELEMETRY_MAGIC;
+	header[len++] = _fields;
+	len += put_varint(header + len, _interval);
+	len += put_varint(header + len, base_time);
+	len += put_varint(header + len, dropped_chunk);
+	uint8_t count_pos = len;
+	len += 3; // Record count, filled in below
+	for (uint8_t f = 0; f < TELEMETRY_FIELDS; f++) {
+		if (_fields & (1<<f)) len += put_varint(header + len, base[f]);
+	}
+
+	uint16_t n = 0, bytes = len, pos = tail;
+	while (n < count) {
+		uint16_t l = record_length(pos);
+		if (bytes + l > max_bytes && n) break;
+		for (uint16_t i = 0; i < l; i++) next(pos);
+		bytes += l;
+		n++;
+	}
+
+	// Record count as a fixed 3 byte varint so the header length is known up front
+	header[count_pos]   = (n & 0x7F) | 0x80;
+	header[count_pos+1] = ((n >> 7) & 0x7F) | 0x80;
+	header[count_pos+2] = n >> 14;
+
+	out.write(header, len);
+	for (uint16_t i = 0; i < n; i++) consume(&out);
+	dropped_chunk = 0;
+	return n;
+}
+
+uint16_t TMC2130Telemetry::records() { return count; }
+uint16_t TMC2130Telemetry::used() { return _used; }
+uint32_t TMC2130Telemetry::dropped() { return _dropped; }
+
+void TMC2130Telemetry::clear() {
+	head = tail = _used = count = 0;
+	dropped_chunk = 0;
+}
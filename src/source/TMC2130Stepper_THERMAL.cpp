@@ -0,0 +1,67 @@
+#include "TMC2130Stepper_THERMAL.h"
+
+TMC2130Thermal::TMC2130Thermal(uint8_t step, uint8_t min_irun, uint16_t interval, uint16_t hysteresis) {
+	_step = step;
+	_min_irun = min_irun;
+	_interval = interval;
+	_hysteresis = hysteresis;
+}
+
+bool TMC2130Thermal::add(TMC2130Stepper &driver) {
+	if (count >= TMC2130_THERMAL_MAX_DRIVERS) return false;
+	axis_t &a = axes[count++];
+	a.driver = &driver;
+	a.irun_nominal = driver.irun();
+	a.level = 0;
+	a.warning = false;
+	a.events = 0;
+	a.last_change = 0;
+	a.clear_since = 0;
+	a.derated_ms = 0;
+	return true;
+}
+
+void TMC2130Thermal::update() {
+	uint32_t now = millis();
+	uint32_t elapsed = now - last_update;
+	last_update = now;
+
+	for (uint8_t i = 0; i < count; i++) {
+		axis_t &a = axes[i];
+		bool warn = a.driver->checkOT();
+		uint8_t irun = a.driver->irun();
+
+		if (a.level) a.derated_ms += elapsed;
+
+		if (warn) {
+			if (!a.warning) {
+				a.warning = true;
+				a.events++;
+				if (!a.level) a.irun_nominal = irun;
+			}
+			if (irun > _min_irun && (!a.level || now - a.last_change >= _interval)) {
+				irun = (irun - _min_irun > _step) ? irun - _step : _min_irun;
+				a.driver->irun(irun);
+				a.level++;
+				a.last_change = now;
+			}
+		} else {
+			if (a.warning) {
+				a.warning = false;
+				a.clear_since = now;
+			}
+			if (a.level && now - a.clear_since >= _hysteresis && now - a.last_change >= _interval) {
+				irun = (a.irun_nominal - irun > _step) ? irun + _step : a.irun_nominal;
+				a.driver->irun(irun);
+				a.last_change = now;
+				if (irun == a.irun_nominal) a.level = 0;
+			}
+		}
+	}
+}
+
+uint8_t TMC2130Thermal::drivers() { return count; }
+bool TMC2130Thermal::derating(uint8_t i) { return i < count && axes[i].level; }
+uint16_t TMC2130Thermal::events(uint8_t i) { return i < count ? axes[i].events : 0; }
+uint32_t TMC2130Thermal::derated_time(uint8_t i) { return i < count ? axes[i].derated_ms : 0; }
+uint8_t TMC2130Thermal::nominal_irun(uint8_t i) { return i < count ? axes[i].irun_nominal : 0; }
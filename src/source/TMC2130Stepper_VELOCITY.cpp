@@ -0,0 +1,52 @@
+#include "TMC2130Stepper.h"
+#include "TMC2130Stepper_MACROS.h"
+
+#define TSTEP_STANDSTILL	0xFFFFFUL
+#define VELOCITY_MAX		0x7FFFFFUL	// Keeps the filter state inside 31 bits
+
+/*
+	TSTEP is the time between two 1/256 microsteps in clock cycles, no
+	matter which resolution is set. With mres microsteps per fullstep the
+	step input frequency is
+
+	steps/s = f_clk * mres / (256 * TSTEP)
+
+	TSTEP saturates at 0xFFFFF when the motor is (nearly) standing still,
+	which is reported as 0. The resolution is taken from the CHOPCONF
+	shadow so no extra SPI access is needed. mres / 256 is 2^-MRES, so
+	f_clk is shifted down instead of multiplied, which cannot overflow.
+*/
+uint32_t TMC2130Stepper::tstep_to_speed(uint32_t tstep) {
+	if (!tstep || tstep >= TSTEP_STANDSTILL) return 0;
+	return (fclk >> TMC2130_n::MRES_f::get(CHOPCONF_sr)) / tstep;
+}
+
+// Inverse of tstep_to_speed(), for setting TPWMTHRS, TCOOLTHRS and THIGH
+uint32_t TMC2130Stepper::speed_to_tstep(uint32_t steps_per_s) {
+	if (!steps_per_s) return TSTEP_STANDSTILL;
+	uint32_t tstep = (fclk >> TMC2130_n::MRES_f::get(CHOPCONF_sr)) / steps_per_s;
+	return tstep > TSTEP_STANDSTILL ? TSTEP_STANDSTILL : tstep;
+}
+
+/*
+	Samples TSTEP and returns the low pass filtered step rate in steps/s.
+	Consecutive calls read TSTEP with one datagram instead of two.
+	The filter is a first order IIR in fixed point:
+
+	v += (sample - v) >> shift
+
+	shift 0 turns the filter off, every step of shift doubles the time
+	constant in samples.
+*/
+uint32_t TMC2130Stepper::velocity() {
+	uint32_t sample = tstep_to_speed(read_pipelined(REG_TSTEP) & TSTEP_bm);
+	if (sample > VELOCITY_MAX) sample = VELOCITY_MAX;
+	velocity_last = sample;
+	int32_t diff = (int32_t)(sample << 8) - (int32_t)velocity_sr;
+	velocity_sr += diff >> velocity_shift;
+	return (velocity_sr + 0x80) >> 8;
+}
+
+uint32_t TMC2130Stepper::velocity_raw() { return velocity_last; }
+
+void TMC2130Stepper::velocity_filter(uint8_t shift) { velocity_shift = shift > 15 ? 15 : shift; }